@@ -1,6 +1,64 @@
 file(READ src/glsl/shader.vert SRC_VERT HEX)
 file(READ src/glsl/shader.frag SRC_FRAG HEX)
+file(READ src/glsl/mandelbrot.glsl SRC_MANDELBROT HEX)
+file(READ src/glsl/aa.frag SRC_AA HEX)
+file(READ src/glsl/colorize.frag SRC_COLORIZE HEX)
+file(READ src/glsl/histogram.vert SRC_HISTOGRAM_VERT HEX)
+file(READ src/glsl/histogram.frag SRC_HISTOGRAM_FRAG HEX)
+file(READ src/glsl/prefix_sum.frag SRC_PREFIX_SUM HEX)
+file(READ src/glsl/iterate.comp SRC_ITERATE HEX)
+file(READ src/glsl/dispatch.comp SRC_DISPATCH HEX)
 string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_VERT "${SRC_VERT}")
 string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_FRAG "${SRC_FRAG}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_MANDELBROT "${SRC_MANDELBROT}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_AA "${SRC_AA}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_COLORIZE "${SRC_COLORIZE}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_HISTOGRAM_VERT "${SRC_HISTOGRAM_VERT}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_HISTOGRAM_FRAG "${SRC_HISTOGRAM_FRAG}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_PREFIX_SUM "${SRC_PREFIX_SUM}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_ITERATE "${SRC_ITERATE}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " HEXDUMP_DISPATCH "${SRC_DISPATCH}")
+
+# Compile-time shader variants. Every axis is a list of values, each
+# variant defines AXIS_VALUE for one value of every axis. The same names
+# become C++ enums, variants are indexed with the first axis as the most
+# significant digit.
+set(SHADER_VARIANT_AXES PRECISION FORMULA COLORING INTERIOR)
+set(PRECISION_VALUES FLOAT DOUBLE)
+set(FORMULA_VALUES MANDELBROT BURNING_SHIP TRICORN)
+set(COLORING_VALUES ITERATIONS DISTANCE)
+set(INTERIOR_VALUES UNCHECKED CHECKED)
+
+set(SHADER_VARIANT_ENUMS "")
+# Starts as a single empty prefix, CMake has no lists of empty strings
+set(VARIANT_DEFINES "@")
+foreach(AXIS ${SHADER_VARIANT_AXES})
+    string(SUBSTRING ${AXIS} 0 1 AXIS_HEAD)
+    string(SUBSTRING ${AXIS} 1 -1 AXIS_TAIL)
+    string(TOLOWER ${AXIS_TAIL} AXIS_TAIL)
+    string(APPEND SHADER_VARIANT_ENUMS "enum Variant${AXIS_HEAD}${AXIS_TAIL} {")
+    set(FIRST_VALUE TRUE)
+    foreach(VALUE ${${AXIS}_VALUES})
+        if(FIRST_VALUE)
+            string(APPEND SHADER_VARIANT_ENUMS " ${AXIS}_${VALUE} = 0,")
+            set(FIRST_VALUE FALSE)
+        else()
+            string(APPEND SHADER_VARIANT_ENUMS " ${AXIS}_${VALUE},")
+        endif()
+    endforeach()
+    string(APPEND SHADER_VARIANT_ENUMS " ${AXIS}_TOTAL };\n")
+
+    set(NEXT_DEFINES "")
+    foreach(PREFIX ${VARIANT_DEFINES})
+        foreach(VALUE ${${AXIS}_VALUES})
+            list(APPEND NEXT_DEFINES "${PREFIX}#define ${AXIS}_${VALUE}\\n")
+        endforeach()
+    endforeach()
+    set(VARIANT_DEFINES ${NEXT_DEFINES})
+endforeach()
+string(REPLACE "@" "" VARIANT_DEFINES "${VARIANT_DEFINES}")
+list(LENGTH VARIANT_DEFINES SHADER_VARIANT_COUNT)
+string(REPLACE ";" "\",\n    \"" SHADER_VARIANT_DEFINES "${VARIANT_DEFINES}")
+
 configure_file(src/cpp/shader_sources.hpp.in "${CMAKE_CURRENT_SOURCE_DIR}/src/cpp/shader_sources.hpp")
 
@@ -0,0 +1,157 @@
+// Throughput and accuracy of the CPU kernels over zoom depths, to place the
+// switches from double to fixed point, double-double and perturbation.
+// Built with -DHW01_BENCHMARKS=ON.
+// Every kernel renders the same small Mandelbrot view and its smooth
+// iteration counts are compared with a __float128 reference, where the
+// compiler provides one. Last, a view centred on a located nucleus is
+// rendered from its periodic orbit, which must leave no glitched pixel.
+
+#include "cpu_kernels.hpp"
+#include "nucleus.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr int WIDTH = 64;
+constexpr int HEIGHT = 64;
+constexpr int ITERATIONS = 512;
+// Smooth iteration counts further apart count as a wrong pixel
+constexpr double TOLERANCE = 0.01;
+// The nucleus is searched for around this point of the real axis
+constexpr double NUCLEUS_X = -1.98554037165413;
+constexpr double NUCLEUS_RADIUS = 1e-10;
+constexpr int NUCLEUS_ITERATIONS = 65536;
+
+struct Result {
+  double ms = 0.0;
+  std::vector<float> data;
+};
+
+Result run(CpuKernel kernel, const CpuView &view) {
+  Result result;
+  result.data.assign(4 * WIDTH * HEIGHT, 0.0f);
+  auto start = std::chrono::steady_clock::now();
+  kernel(view, 0, WIDTH * HEIGHT, result.data.data());
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.ms = elapsed.count();
+  return result;
+}
+
+// Approximations over the reference orbit of the current depth
+BlaTable bla_table;
+
+CpuKernelStats render_pixels_bla(const CpuView &view, int begin, int end,
+                                 float *out) {
+  CpuView with_bla = view;
+  with_bla.bla = &bla_table;
+  return cpu_kernels::render_pixels_perturbation<false>(with_bla, begin, end,
+                                                        out);
+}
+
+double wrong_pixels(const Result &result, const Result &reference) {
+  int wrong = 0;
+  for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+    float a = result.data[4 * i], b = reference.data[4 * i];
+    wrong += std::abs(a - b) > TOLERANCE * std::max(1.0f, std::abs(b));
+  }
+  return 100.0 * wrong / (WIDTH * HEIGHT);
+}
+
+} // namespace
+
+int main() {
+  using namespace cpu_kernels;
+  struct Kernel {
+    const char *name;
+    CpuKernel kernel;
+  };
+  std::vector<Kernel> kernels = {
+      {"double", render_pixels<double, FORMULA_MANDELBROT, 2, false, false>},
+      {"fixed", render_pixels<Fixed, FORMULA_MANDELBROT, 2, false, false>},
+      {"dd", render_pixels<DoubleDouble, FORMULA_MANDELBROT, 2, false, false>},
+  };
+#ifdef CPU_KERNELS_AVX2
+  if (has_avx2_fma()) {
+    kernels.push_back(
+        {"dd avx2", render_pixels_avx2<FORMULA_MANDELBROT, false, false>});
+  }
+#endif
+  kernels.push_back({"perturbation", render_pixels_perturbation<false>});
+  kernels.push_back({"bla", render_pixels_bla});
+#ifdef __SIZEOF_FLOAT128__
+  kernels.push_back(
+      {"float128",
+       render_pixels<__float128, FORMULA_MANDELBROT, 2, false, false>});
+#endif
+
+  std::printf("%-8s", "scale");
+  for (const Kernel &kernel : kernels) {
+    std::printf(" %20s", kernel.name);
+  }
+  std::printf("\n%-8s", "");
+  for (std::size_t i = 0; i < kernels.size(); ++i) {
+    std::printf(" %9s %10s", "ms", "wrong %");
+  }
+  std::printf("\n");
+
+  for (int depth = 0; depth <= 30; depth += 3) {
+    // c = i lands on a repelling cycle, so the pixels around it escape
+    // at every depth, after a number of iterations growing with the depth
+    CpuView view = {};
+    view.width = WIDTH;
+    view.height = HEIGHT;
+    view.point_x = DoubleDouble(0.0);
+    view.point_y = DoubleDouble(1.0);
+    view.scale = std::pow(10.0, depth);
+    view.iterations = ITERATIONS;
+    // Not part of the timings
+    ReferenceOrbit reference;
+    int limbs = BigFixed::limbs_for_bits(4 * depth + 64);
+    reference.compute(BigFixed(limbs), BigFixed::from_double(1.0, 0, limbs),
+                      ITERATIONS, BAILOUT<double>);
+    view.reference = &reference;
+    bla_table.build(reference,
+                    FloatExp(std::sqrt(2.0)) / FloatExp(view.scale));
+    std::vector<Result> results;
+    for (const Kernel &kernel : kernels) {
+      results.push_back(run(kernel.kernel, view));
+    }
+    std::printf("1e%-6d", depth);
+    for (const Result &result : results) {
+      std::printf(" %9.2f %10.1f", result.ms,
+                  wrong_pixels(result, results.back()));
+    }
+    std::printf("\n");
+  }
+
+  int limbs = BigFixed::limbs_for_bits(64 - std::ilogb(NUCLEUS_RADIUS));
+  Nucleus nucleus = locate_nucleus(
+      BigFixed::from_double(NUCLEUS_X, 0, limbs), BigFixed(limbs),
+      NUCLEUS_RADIUS, NUCLEUS_RADIUS, NUCLEUS_ITERATIONS);
+  if (!nucleus.period) {
+    std::printf("No nucleus found\n");
+    return 1;
+  }
+  ReferenceOrbit periodic;
+  periodic.compute_periodic(nucleus.x, nucleus.y, nucleus.period,
+                            BAILOUT<double>);
+  CpuView view = {};
+  view.width = WIDTH;
+  view.height = HEIGHT;
+  view.scale = FloatExp(0.5) / nucleus.size;
+  view.iterations = NUCLEUS_ITERATIONS;
+  view.reference = &periodic;
+  std::vector<std::uint8_t> glitches(WIDTH * HEIGHT, 0);
+  view.glitches = glitches.data();
+  Result result = run(render_pixels_perturbation<false>, view);
+  int glitched = int(std::count(glitches.begin(), glitches.end(), 1));
+  std::printf("Nucleus of period %d at 1e%.1f: %.2f ms, %d glitched "
+              "pixels\n",
+              nucleus.period, log2(view.scale) * std::log10(2.0), result.ms,
+              glitched);
+  return glitched ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+#ifndef big_fixed_hpp_INCLUDED
+#define big_fixed_hpp_INCLUDED
+
+#include "double_double.hpp"
+#include "fixed_point.hpp"
+#include "float_exp.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Signed fixed point of any precision: a sign and a magnitude of 64-bit
+// limbs in little-endian order. The last limb is the integer part, the
+// others the fraction. Operands of different precisions are extended to the
+// larger one. Holds what no hardware type can at deep zooms, the point the
+// camera looks at and the reference orbits through it.
+struct BigFixed {
+  bool negative = false;
+  std::vector<std::uint64_t> limbs = {0};
+
+  BigFixed() = default;
+  explicit BigFixed(int fraction_limbs) : limbs(fraction_limbs + 1) {}
+
+  // Fraction limbs that hold bits binary places, rounded up
+  static int limbs_for_bits(int bits) { return std::max(1, (bits + 63) / 64); }
+
+  // value * 2^exponent, truncated to the precision
+  static BigFixed from_double(double value, int exponent,
+                              int fraction_limbs) {
+    BigFixed result(fraction_limbs);
+    if (value == 0.0 || !std::isfinite(value)) {
+      return result;
+    }
+    result.negative = value < 0.0;
+    int e;
+    double mantissa = std::frexp(std::abs(value), &e);
+    auto bits = std::uint64_t(std::ldexp(mantissa, 53));
+    // Position of the lowest bit of the mantissa
+    int shift = e + exponent - 53 + 64 * fraction_limbs;
+    if (shift < 0) {
+      if (shift <= -64) {
+        result.negative = false;
+        return result;
+      }
+      bits >>= -shift;
+      shift = 0;
+    }
+    std::size_t limb = shift / 64;
+    int bit = shift % 64;
+    if (limb < result.limbs.size()) {
+      result.limbs[limb] |= bits << bit;
+    }
+    if (bit && limb + 1 < result.limbs.size()) {
+      result.limbs[limb + 1] |= bits >> (64 - bit);
+    }
+    return result;
+  }
+
+  static BigFixed from_double_double(DoubleDouble value, int fraction_limbs) {
+    return from_double(value.hi, 0, fraction_limbs) +
+           from_double(value.lo, 0, fraction_limbs);
+  }
+
+  int fraction_limbs() const noexcept { return int(limbs.size()) - 1; }
+
+  // Drops or appends low limbs
+  void set_fraction_limbs(int fraction_limbs) {
+    int change = fraction_limbs - this->fraction_limbs();
+    if (change > 0) {
+      limbs.insert(limbs.begin(), change, 0);
+    } else if (change < 0) {
+      limbs.erase(limbs.begin(), limbs.begin() - change);
+    }
+  }
+
+  bool is_zero() const noexcept {
+    return std::all_of(limbs.begin(), limbs.end(),
+                       [](std::uint64_t limb) { return limb == 0; });
+  }
+
+  // From the two highest nonzero limbs
+  double to_double() const noexcept {
+    int f = fraction_limbs();
+    for (int i = f; i >= 0; --i) {
+      if (limbs[i] == 0) {
+        continue;
+      }
+      double result = std::ldexp(double(limbs[i]), 64 * (i - f));
+      if (i > 0) {
+        result += std::ldexp(double(limbs[i - 1]), 64 * (i - 1 - f));
+      }
+      return negative ? -result : result;
+    }
+    return 0.0;
+  }
+
+  // Same, without the range of a double, for differences of deep points
+  FloatExp to_float_exp() const noexcept {
+    int f = fraction_limbs();
+    for (int i = f; i >= 0; --i) {
+      if (limbs[i] == 0) {
+        continue;
+      }
+      double mantissa = double(limbs[i]);
+      if (i > 0) {
+        mantissa += std::ldexp(double(limbs[i - 1]), -64);
+      }
+      return {negative ? -mantissa : mantissa, 64 * (i - f)};
+    }
+    return {};
+  }
+
+  DoubleDouble to_double_double() const {
+    double hi = to_double();
+    return {hi, (*this - from_double(hi, 0, fraction_limbs())).to_double()};
+  }
+
+  BigFixed operator-() const {
+    BigFixed result = *this;
+    result.negative = !negative && !is_zero();
+    return result;
+  }
+
+  friend BigFixed operator+(BigFixed a, BigFixed b) {
+    align(a, b);
+    if (a.negative == b.negative) {
+      add_magnitude(a.limbs, b.limbs);
+      return a;
+    }
+    if (!less_magnitude(a.limbs, b.limbs)) {
+      subtract_magnitude(a.limbs, b.limbs);
+      a.negative = a.negative && !a.is_zero();
+      return a;
+    }
+    subtract_magnitude(b.limbs, a.limbs);
+    return b;
+  }
+
+  friend BigFixed operator-(const BigFixed &a, const BigFixed &b) {
+    return a + -b;
+  }
+
+  // Schoolbook product without the partial products that only reach below
+  // the lowest limb, so the last limb may be off by a few units
+  friend BigFixed operator*(BigFixed a, BigFixed b) {
+    align(a, b);
+    int n = int(a.limbs.size());
+    int f = n - 1;
+    std::vector<std::uint64_t> product(2 * n, 0);
+    for (int i = 0; i < n; ++i) {
+      std::uint64_t carry = 0;
+      for (int j = std::max(0, f - 1 - i); j < n; ++j) {
+        std::uint64_t hi, lo;
+        multiply_wide(a.limbs[i], b.limbs[j], hi, lo);
+        std::uint64_t sum = product[i + j] + lo;
+        hi += sum < lo;
+        std::uint64_t with_carry = sum + carry;
+        hi += with_carry < carry;
+        product[i + j] = with_carry;
+        carry = hi;
+      }
+      product[i + n] = carry;
+    }
+    BigFixed result;
+    result.limbs.assign(product.begin() + f, product.begin() + f + n);
+    result.negative = a.negative != b.negative && !result.is_zero();
+    return result;
+  }
+
+private:
+  static void align(BigFixed &a, BigFixed &b) {
+    int fraction_limbs = std::max(a.fraction_limbs(), b.fraction_limbs());
+    a.set_fraction_limbs(fraction_limbs);
+    b.set_fraction_limbs(fraction_limbs);
+  }
+
+  static bool less_magnitude(const std::vector<std::uint64_t> &a,
+                             const std::vector<std::uint64_t> &b) {
+    return std::lexicographical_compare(a.rbegin(), a.rend(), b.rbegin(),
+                                        b.rend());
+  }
+
+  static void add_magnitude(std::vector<std::uint64_t> &a,
+                            const std::vector<std::uint64_t> &b) {
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      std::uint64_t sum = a[i] + b[i];
+      std::uint64_t next_carry = sum < b[i];
+      a[i] = sum + carry;
+      carry = next_carry | (a[i] < carry);
+    }
+  }
+
+  // a -= b, given a >= b
+  static void subtract_magnitude(std::vector<std::uint64_t> &a,
+                                 const std::vector<std::uint64_t> &b) {
+    std::uint64_t borrow = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      std::uint64_t difference = a[i] - b[i];
+      std::uint64_t next_borrow = a[i] < b[i];
+      next_borrow |= difference < borrow;
+      a[i] = difference - borrow;
+      borrow = next_borrow;
+    }
+  }
+};
+
+#endif // big_fixed_hpp_INCLUDED
@@ -0,0 +1,95 @@
+#ifndef bla_table_hpp_INCLUDED
+#define bla_table_hpp_INCLUDED
+
+#include "float_exp.hpp"
+#include "reference_orbit.hpp"
+
+#include <cmath>
+#include <vector>
+
+// Bilinear approximation of the perturbed iterations m .. m + 2^level of
+// a reference orbit: dz_{m + 2^level} = A dz_m + B dc, which holds while
+// |dz_m| < radius. A and B do not depend on the scale of dz, so they are
+// plain doubles.
+struct Bla {
+  double ax = 0.0;
+  double ay = 0.0;
+  double bx = 0.0;
+  double by = 0.0;
+  FloatExp radius;
+};
+
+// Approximations over a reference orbit in a binary tree. Level 0 covers
+// single iterations m = 1, 2, ..., each higher level merges pairs of the
+// one below, so every iteration starts approximations of all lengths up to
+// its alignment. The radii get smaller with the length for the same start.
+// Compressed orbits are too long for an entry per iteration, their tables
+// start at blocks of 2^COMPRESSED_FIRST_LEVEL iterations and levels[i]
+// holds the level first_level + i.
+struct BlaTable {
+  static constexpr int COMPRESSED_FIRST_LEVEL = 4;
+
+  std::vector<std::vector<Bla>> levels;
+  int first_level = 0;
+
+  // A single iteration drops dz^2 from dz' = 2Z dz + dz^2 + dc, which is
+  // below epsilon relative to 2Z dz while |dz| < epsilon |2Z|. max_dc is
+  // the largest |dc| of the view. A compressed orbit is read from windows,
+  // if any, where they hold it.
+  void build(const ReferenceOrbit &orbit, FloatExp max_dc,
+             const OrbitWindows *windows = nullptr,
+             double epsilon = 0x1p-32) {
+    levels.clear();
+    first_level = orbit.is_compressed() ? COMPRESSED_FIRST_LEVEL : 0;
+    OrbitReader reader(orbit, windows);
+    std::vector<Bla> level;
+    int block = 1 << first_level;
+    for (int m = 1; m + block < orbit.size(); m += block) {
+      Bla merged;
+      for (int i = m; i < m + block; ++i) {
+        if (i >= reader.end) {
+          reader.load(reader.window_of(i));
+        }
+        Bla bla;
+        bla.ax = 2.0 * reader.x[i - reader.begin];
+        bla.ay = 2.0 * reader.y[i - reader.begin];
+        bla.bx = 1.0;
+        bla.radius = epsilon * std::hypot(bla.ax, bla.ay);
+        merged = i == m ? bla : merge(merged, bla, max_dc);
+      }
+      level.push_back(merged);
+    }
+    while (!level.empty()) {
+      std::vector<Bla> merged;
+      for (std::size_t j = 0; j + 1 < level.size(); j += 2) {
+        merged.push_back(merge(level[j], level[j + 1], max_dc));
+      }
+      levels.push_back(std::move(level));
+      level = std::move(merged);
+    }
+  }
+
+  // x, then y
+  static Bla merge(const Bla &x, const Bla &y, FloatExp max_dc) {
+    Bla bla;
+    bla.ax = y.ax * x.ax - y.ay * x.ay;
+    bla.ay = y.ax * x.ay + y.ay * x.ax;
+    bla.bx = y.ax * x.bx - y.ay * x.by + y.bx;
+    bla.by = y.ax * x.by + y.ay * x.bx + y.by;
+    // dz_y = A_x dz + B_x dc has to be within the radius of y
+    double a = std::hypot(x.ax, x.ay);
+    double b = std::hypot(x.bx, x.by);
+    FloatExp y_radius = (y.radius - max_dc * b) / a;
+    bla.radius = y_radius < x.radius ? y_radius : x.radius;
+    // Coefficients that large would overflow the products with dz, and
+    // are never within the radius anyway
+    constexpr double LIMIT = 0x1p512;
+    if (!(y_radius.mantissa > 0.0) || !(std::hypot(bla.ax, bla.ay) < LIMIT) ||
+        !(std::hypot(bla.bx, bla.by) < LIMIT)) {
+      bla.radius = {};
+    }
+    return bla;
+  }
+};
+
+#endif // bla_table_hpp_INCLUDED
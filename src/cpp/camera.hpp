@@ -0,0 +1,182 @@
+#ifndef camera_hpp_INCLUDED
+#define camera_hpp_INCLUDED
+
+#include "big_fixed.hpp"
+#include "double_double.hpp"
+#include "float_exp.hpp"
+
+#include <SDL.h>
+#include <algorithm>
+
+// View transition between two states, interpolated by SDL ticks. Screen
+// space is ssx = (2x - w) / min_dim and a point maps to anchor + (ssx +
+// center) / scale. Every transition first moves the anchor to the middle of
+// the view, so the center stays small and the anchor, in as many bits as
+// the scale needs, carries the position. The scale has its own exponent to
+// zoom past the range of a double.
+struct Camera {
+  int last_update_tick = 0;
+  int next_update_tick = 0;
+  BigFixed anchor_x;
+  BigFixed anchor_y;
+  // Incremented each time the anchor moves
+  unsigned anchor_version = 0;
+  DoubleDouble last_center_x;
+  DoubleDouble last_center_y;
+  DoubleDouble next_center_x;
+  DoubleDouble next_center_y;
+  FloatExp last_scale = 1.0;
+  FloatExp next_scale = 1.0;
+  // Performance counter of the newest input that moved the camera, and how
+  // long the oldest input applied with it waited in the event queue
+  Uint64 input_counter = 0;
+  Uint32 input_queued_ms = 0;
+
+  // Fraction limbs that place the pixels of views at scale apart, with
+  // room for windows a few thousand pixels wide and for rounding
+  static int fraction_limbs_for(FloatExp scale) {
+    return BigFixed::limbs_for_bits(std::max(0, int(log2(scale))) + 96);
+  }
+
+  template <typename T> T lerp(T last, T next, int tick) const noexcept {
+    if (last_update_tick == next_update_tick) {
+      return next;
+    }
+    double progress = double(tick - last_update_tick) /
+                      (next_update_tick - last_update_tick);
+    progress = std::max(0.0, std::min(1.0, progress));
+    // Exact at both ends, even for scales too far apart for a difference
+    return last * (1.0 - progress) + next * progress;
+  }
+
+  // Relative to the anchor
+  DoubleDouble center_x(int tick) const noexcept {
+    return lerp(last_center_x, next_center_x, tick);
+  }
+
+  DoubleDouble center_y(int tick) const noexcept {
+    return lerp(last_center_y, next_center_y, tick);
+  }
+
+  FloatExp scale(int tick) const noexcept {
+    return lerp(last_scale, next_scale, tick);
+  }
+
+  // Point of the plane in the middle of the view, rounded to double-double
+  DoubleDouble point_x(int tick) const {
+    return anchor_x.to_double_double() + offset(center_x(tick), tick);
+  }
+
+  DoubleDouble point_y(int tick) const {
+    return anchor_y.to_double_double() + offset(center_y(tick), tick);
+  }
+
+  // Same, exactly
+  BigFixed exact_point_x(int tick, int fraction_limbs) const {
+    return anchor_x + exact_offset(center_x(tick), tick, fraction_limbs);
+  }
+
+  BigFixed exact_point_y(int tick, int fraction_limbs) const {
+    return anchor_y + exact_offset(center_y(tick), tick, fraction_limbs);
+  }
+
+  // Center in screen units from the origin instead of the anchor, for the
+  // renderers that have no anchor. Only finite at shallow zooms.
+  DoubleDouble absolute_center_x(int tick) const {
+    return anchor_x.to_double_double() * double(scale(tick)) +
+           center_x(tick);
+  }
+
+  DoubleDouble absolute_center_y(int tick) const {
+    return anchor_y.to_double_double() * double(scale(tick)) +
+           center_y(tick);
+  }
+
+  // Starts a transition from wherever the camera is at tick
+  void start_transition(int tick, int duration) {
+    DoubleDouble cx = center_x(tick);
+    DoubleDouble cy = center_y(tick);
+    FloatExp s = scale(tick);
+    if (cx.hi != 0.0 || cy.hi != 0.0) {
+      int limbs = fraction_limbs_for(s);
+      anchor_x = exact_point_x(tick, limbs);
+      anchor_y = exact_point_y(tick, limbs);
+      ++anchor_version;
+    }
+    last_center_x = last_center_y = {};
+    last_scale = s;
+    last_update_tick = tick;
+    next_update_tick = tick + duration;
+  }
+
+  // Zooms keeping the point under (x, y) in place
+  void scroll(int tick, int duration, int w, int h, double x, double y,
+              double factor) {
+    int min_dim = std::min(w, h);
+    start_transition(tick, duration);
+    next_scale = last_scale * factor;
+
+    // The point under (x, y) stays there while the scale changes:
+    // (ssx + cx) / s = (ssx + cx') / s', so cx' = (ssx + cx) * factor - ssx.
+    // The centers are then linear in the scale and so is the
+    // interpolation between them.
+    double ssx = (2 * x - w) / double(min_dim);
+    double ssy = (h - 2 * y) / double(min_dim);
+    next_center_x = (last_center_x + ssx) * factor - ssx;
+    next_center_y = (last_center_y + ssy) * factor - ssy;
+  }
+
+  void drag(int tick, int w, int h, double xrel, double yrel) {
+    int min_dim = std::min(w, h);
+    start_transition(tick, 0);
+    DoubleDouble cx = last_center_x;
+    DoubleDouble cy = last_center_y;
+
+    // ((2x - w) / min_dim + cx) / s = ((2x' - w) / min_dim + cx') / s
+    // (2x - w) / min_dim + cx = (2x' - w) / min_dim + cx'
+    // dcx = -2dx / min_dim
+    cx = cx - 2.0 * xrel / min_dim;
+    cy = cy + 2.0 * yrel / min_dim;
+
+    last_center_x = next_center_x = cx;
+    last_center_y = next_center_y = cy;
+    next_scale = last_scale;
+  }
+
+  // Moves the anchor to (x, y), which the view then zooms into at scale
+  void zoom_to(int tick, int duration, const BigFixed &x, const BigFixed &y,
+               FloatExp scale) {
+    start_transition(tick, duration);
+    // The middle of the view stays where it is relative to the new anchor
+    last_center_x = double((anchor_x - x).to_float_exp() * last_scale);
+    last_center_y = double((anchor_y - y).to_float_exp() * last_scale);
+    anchor_x = x;
+    anchor_y = y;
+    ++anchor_version;
+    next_center_x = next_center_y = {};
+    next_scale = scale;
+  }
+
+  void reset(int tick, int duration) {
+    start_transition(tick, duration);
+    next_scale = 1.0;
+    next_center_x = -anchor_x.to_double_double();
+    next_center_y = -anchor_y.to_double_double();
+  }
+
+private:
+  // center / scale, where 1 / scale may round to 0 at deep zooms
+  DoubleDouble offset(DoubleDouble center, int tick) const noexcept {
+    return center * double(FloatExp(1.0) / scale(tick));
+  }
+
+  BigFixed exact_offset(DoubleDouble center, int tick,
+                        int fraction_limbs) const {
+    FloatExp s = scale(tick);
+    DoubleDouble q = center / s.mantissa;
+    return BigFixed::from_double(q.hi, -s.exponent, fraction_limbs) +
+           BigFixed::from_double(q.lo, -s.exponent, fraction_limbs);
+  }
+};
+
+#endif // camera_hpp_INCLUDED
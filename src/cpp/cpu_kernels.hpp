@@ -0,0 +1,649 @@
+#ifndef cpu_kernels_hpp_INCLUDED
+#define cpu_kernels_hpp_INCLUDED
+
+// Escape-time kernels on the CPU, in double, fixed point or double-double,
+// and perturbation of a reference orbit beyond. Every combination of
+// formula, power and Julia mode is a separate instantiation, so the inner
+// loop has no branches on the settings and z^d is an unrolled sequence of
+// multiplications.
+
+#include "bla_table.hpp"
+#include "double_double.hpp"
+#include "fixed_point.hpp"
+#include "float_exp.hpp"
+#include "reference_orbit.hpp"
+#include "shader_sources.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+constexpr int CPU_MIN_POWER = 2;
+constexpr int CPU_MAX_POWER = 8;
+
+// Fixed point and double-double kernels only exist for the power 2,
+// perturbation only for the Mandelbrot set
+enum CpuPrecision {
+  CPU_PRECISION_DOUBLE = 0,
+  CPU_PRECISION_FIXED,
+  CPU_PRECISION_DOUBLE_DOUBLE,
+  CPU_PRECISION_PERTURBATION
+};
+
+// Cheapest number type that still tells neighbouring pixels apart, keeping
+// a few bits for the rounding that builds up over the iterations. magnitude
+// is the largest coordinate of the view's point, radius the distance from
+// the origin of the farthest point the iteration starts from or adds. Fixed
+// point holds the iteration only while that stays below 2.
+inline CpuPrecision cpu_precision_for(FloatExp pixel_size, double magnitude,
+                                      double radius) {
+  double bits = -log2(pixel_size) + std::log2(std::max(magnitude, 1.0));
+  if (bits <= 48.0) {
+    return CPU_PRECISION_DOUBLE;
+  }
+  if (radius < 2.0 && -log2(pixel_size) <= 56.0) {
+    return CPU_PRECISION_FIXED;
+  }
+  return bits <= 100.0 ? CPU_PRECISION_DOUBLE_DOUBLE
+                       : CPU_PRECISION_PERTURBATION;
+}
+
+// Nearest precision at or below precision with kernels for the settings
+inline CpuPrecision supported_cpu_precision(CpuPrecision precision,
+                                            VariantFormula formula,
+                                            int power, bool julia) {
+  if (power != 2) {
+    return CPU_PRECISION_DOUBLE;
+  }
+  if (precision == CPU_PRECISION_PERTURBATION &&
+      (formula != FORMULA_MANDELBROT || julia)) {
+    return CPU_PRECISION_DOUBLE_DOUBLE;
+  }
+  return precision;
+}
+
+struct CpuView {
+  int width;
+  int height;
+  // Point of the plane in the middle of the image
+  DoubleDouble point_x;
+  DoubleDouble point_y;
+  FloatExp scale;
+  int iterations;
+  bool interior_checks;
+  // Julia sets iterate from the pixel with this constant instead
+  double julia_x;
+  double julia_y;
+  // Orbit of a point near the view for the perturbation kernels, and the
+  // middle of the view relative to that point
+  const ReferenceOrbit *reference = nullptr;
+  FloatExp reference_dx;
+  FloatExp reference_dy;
+  // Approximations over that orbit to skip iterations with, if any, that
+  // hold for the pixels of the view
+  const BlaTable *bla = nullptr;
+  // Start of the reference orbit regenerated once for all calls, if it is
+  // compressed
+  const OrbitWindows *reference_windows = nullptr;
+  // The perturbation kernel renders the pixels listed here instead, if
+  // any, indexed by [begin, end), and flags those that outlast the
+  // reference in glitches, if any, instead of carrying on
+  const int *pixels = nullptr;
+  std::uint8_t *glitches = nullptr;
+};
+
+// Lane-steps spent by a kernel call, the ratio is the lane occupancy. The
+// perturbation kernel also counts the iterations its steps advanced, which
+// are more than the steps where approximations skip ahead, and the
+// iterations of a compressed reference orbit it regenerated.
+struct CpuKernelStats {
+  std::uint64_t active_steps = 0;
+  std::uint64_t lane_steps = 0;
+  std::uint64_t iterations = 0;
+  std::uint64_t regenerated = 0;
+
+  CpuKernelStats &operator+=(const CpuKernelStats &other) noexcept {
+    active_steps += other.active_steps;
+    lane_steps += other.lane_steps;
+    iterations += other.iterations;
+    regenerated += other.regenerated;
+    return *this;
+  }
+};
+
+// Writes the pixels [begin, end) of the image in row-major order, as RGBA
+// values in the layout produced by the fractal pass
+using CpuKernel = CpuKernelStats (*)(const CpuView &view, int begin, int end,
+                                     float *out);
+
+namespace cpu_kernels {
+
+// Enough independent pixels per step for the compiler to vectorize the
+// lane loops without -march flags
+constexpr int LANES = 8;
+
+template <int D, typename Real>
+inline void complex_pow(Real x, Real y, Real &rx, Real &ry) {
+  if constexpr (D == 1) {
+    rx = x;
+    ry = y;
+  } else if constexpr (D % 2 == 0) {
+    Real hx, hy;
+    complex_pow<D / 2>(x, y, hx, hy);
+    rx = hx * hx - hy * hy;
+    ry = 2.0 * hx * hy;
+  } else {
+    Real hx, hy;
+    complex_pow<D - 1>(x, y, hx, hy);
+    rx = hx * x - hy * y;
+    ry = hx * y + hy * x;
+  }
+}
+
+inline bool in_main_components(double cx, double cy) {
+  double x = cx - 0.25;
+  double q = x * x + cy * cy;
+  if (q * (q + x) <= 0.25 * cy * cy) {
+    return true;
+  }
+  double x1 = cx + 1.0;
+  return x1 * x1 + cy * cy <= 0.0625;
+}
+
+// Squared radius past which a pixel counts as escaped. Fixed point
+// overflows beyond 8, so its kernels stop at the radius 2 and the few
+// iterations the smooth count needs beyond that run in double.
+template <typename Real> inline constexpr double BAILOUT = 65536.0;
+template <> inline constexpr double BAILOUT<Fixed> = 4.0;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_KERNELS_AVX2
+#define CPU_KERNELS_INLINE inline __attribute__((always_inline))
+#else
+#define CPU_KERNELS_INLINE inline
+#endif
+
+// Pixels escape after very different iteration counts, so lanes are not
+// iterated in fixed groups. Every lane holds its own pixel and as soon as it
+// escapes or reaches the limit, its result is written and the lane takes
+// the next pending pixel. The lanes only run idle once the range runs out.
+// Real is double, Fixed, a DoubleDoubleT or any other type with the
+// arithmetic operators. The derivative for the distance estimate is only a
+// magnitude and stays in double.
+template <typename Real, VariantFormula F, int D, bool Julia, bool Distance>
+CPU_KERNELS_INLINE CpuKernelStats render_pixels(const CpuView &view,
+                                                int begin, int end,
+                                                float *out) {
+  using std::abs;
+  constexpr double LIMIT = 65536.0;
+  const double min_dim = std::min(view.width, view.height);
+  const double scale = double(view.scale);
+  const double pixel_size = 2.0 / (min_dim * scale);
+  const double inv_log_power = 1.0 / std::log(double(D));
+  const Real point_x = Real(view.point_x.hi) + view.point_x.lo;
+  const Real point_y = Real(view.point_y.hi) + view.point_y.lo;
+
+  Real zx[LANES], zy[LANES], cx[LANES], cy[LANES];
+  double dzx[LANES], dzy[LANES];
+  int count[LANES];
+  // Index of the pixel in each lane, negative for idle lanes
+  int pixel[LANES];
+  bool done[LANES];
+  int next = begin;
+  int live = 0;
+  CpuKernelStats stats;
+
+  // One iteration, generic so that escaped pixels can finish in double
+  auto step = [&](auto &x, auto &y, const auto &cx, const auto &cy,
+                  double &dx, double &dy) {
+    auto bx = x, by = y;
+    if constexpr (F == FORMULA_BURNING_SHIP) {
+      bx = abs(bx);
+      by = abs(by);
+    } else if constexpr (F == FORMULA_TRICORN) {
+      by = -by;
+    }
+    decltype(bx) wx, wy;
+    complex_pow<D - 1>(bx, by, wx, wy);
+    if constexpr (Distance) {
+      // Complex derivative for the holomorphic map, its magnitude
+      // otherwise
+      double dwx = to_double(wx), dwy = to_double(wy);
+      double ndx, ndy;
+      if constexpr (F == FORMULA_MANDELBROT) {
+        ndx = D * (dwx * dx - dwy * dy);
+        ndy = D * (dwx * dy + dwy * dx);
+      } else {
+        ndx = D * std::sqrt(dwx * dwx + dwy * dwy) * dx;
+        ndy = 0.0;
+      }
+      if constexpr (!Julia) {
+        ndx += 1.0;
+      }
+      dx = ndx;
+      dy = ndy;
+    }
+    x = wx * bx - wy * by + cx;
+    y = wx * by + wy * bx + cy;
+  };
+
+  auto escaped = [&](int l) {
+    double x = to_double(zx[l]), y = to_double(zy[l]);
+    return x * x + y * y > BAILOUT<Real>;
+  };
+
+  auto finish = [&](int l) {
+    float *result = out + 4 * std::size_t(pixel[l]);
+    double x = to_double(zx[l]);
+    double y = to_double(zy[l]);
+    double r2 = x * x + y * y;
+    if (r2 <= BAILOUT<Real>) {
+      std::fill(result, result + 4, 0.0f);
+      return;
+    }
+    int n = count[l];
+    double dx = dzx[l], dy = dzy[l];
+    while (r2 <= LIMIT) {
+      step(x, y, to_double(cx[l]), to_double(cy[l]), dx, dy);
+      ++n;
+      r2 = x * x + y * y;
+    }
+    double log_r = 0.5 * std::log(r2);
+    double nu = n - std::log(log_r) * inv_log_power;
+    double de = 0.0;
+    if constexpr (Distance) {
+      double dr2 = dx * dx + dy * dy;
+      // dc/dpixel = 2 / (min_dim * scale)
+      de = 0.5 * std::sqrt(r2 / dr2) * log_r * 0.5 * min_dim * scale;
+    }
+    result[0] = std::max(nu, 0.0);
+    result[1] = de;
+    result[2] = 1.0f;
+    result[3] = 0.0f;
+  };
+
+  // Pixels that need no iterations are written right away
+  auto refill = [&](int l) {
+    while (next < end) {
+      int p = next++;
+      int x = p % view.width;
+      int y = p / view.width;
+      Real px = point_x + (x + 0.5 - 0.5 * view.width) * pixel_size;
+      Real py = point_y + (y + 0.5 - 0.5 * view.height) * pixel_size;
+      if constexpr (Julia) {
+        zx[l] = px;
+        zy[l] = py;
+        cx[l] = view.julia_x;
+        cy[l] = view.julia_y;
+      } else {
+        zx[l] = Real(0.0);
+        zy[l] = Real(0.0);
+        cx[l] = px;
+        cy[l] = py;
+      }
+      // Derivative with respect to the pixel's point, which is z0 for Julia
+      // sets and c otherwise
+      dzx[l] = Julia ? 1.0 : 0.0;
+      dzy[l] = 0.0;
+      count[l] = 0;
+      pixel[l] = p;
+      bool interior = false;
+      if constexpr (F == FORMULA_MANDELBROT && D == 2 && !Julia) {
+        interior = view.interior_checks &&
+                   in_main_components(to_double(px), to_double(py));
+      }
+      if (interior) {
+        std::fill(out + 4 * std::size_t(p), out + 4 * std::size_t(p) + 4,
+                  0.0f);
+      } else if (view.iterations <= 0 || escaped(l)) {
+        finish(l);
+      } else {
+        return true;
+      }
+    }
+    // Idle lanes keep iterating zero, which stays finite
+    zx[l] = zy[l] = cx[l] = cy[l] = Real(0.0);
+    dzx[l] = dzy[l] = 0.0;
+    pixel[l] = -1;
+    return false;
+  };
+
+  for (int l = 0; l < LANES; ++l) {
+    live += refill(l);
+  }
+
+  while (live > 0) {
+    bool any_done = false;
+    for (int l = 0; l < LANES; ++l) {
+      step(zx[l], zy[l], cx[l], cy[l], dzx[l], dzy[l]);
+      ++count[l];
+      done[l] =
+          pixel[l] >= 0 && (escaped(l) || count[l] >= view.iterations);
+      any_done |= done[l];
+    }
+    stats.active_steps += live;
+    stats.lane_steps += LANES;
+    if (!any_done) {
+      continue;
+    }
+    for (int l = 0; l < LANES; ++l) {
+      if (done[l]) {
+        finish(l);
+        live -= !refill(l);
+      }
+    }
+  }
+  return stats;
+}
+
+// Deep zooms, where the pixels are too close for any hardware type. Each
+// pixel's orbit z is iterated as its difference dz from the reference orbit
+// Z of a point near the view, dz' = (2Z + dz) dz + dc, which needs few
+// bits. dz is kept as 2^k w, so the loop stays in plain double and only
+// renormalizes w when it grows past 2^64. Where z passes closer to 0 than
+// dz, the pixel continues relative to the start of the reference orbit
+// instead, which keeps the single reference from glitching. The derivative
+// for the distance estimate is rescaled the same way. With a BlaTable, each
+// step takes the longest approximation starting at m that holds for dz,
+// dz = A dz + B dc and dz/dc = A dz/dc + B, and only iterates where none
+// does. Pixels still iterating where an escaped reference ends have no
+// reference left but its start, where dz = z is too large to hold dc, and
+// are flagged as glitches if the caller corrects them with references of
+// their own. The reference is read a window at a time: the pixels keep their
+// state between windows and all of those in the lowest window still needed
+// advance through it together, so a compressed orbit is regenerated about
+// once per call rather than once per pixel, and its start not at all where
+// the view shares its windows.
+template <bool Distance>
+CpuKernelStats render_pixels_perturbation(const CpuView &view, int begin,
+                                          int end, float *out) {
+  constexpr double LIMIT = BAILOUT<double>;
+  const ReferenceOrbit &reference = *view.reference;
+  const BlaTable *bla = view.bla;
+  const int reference_end = reference.size() - 1;
+  const double min_dim = std::min(view.width, view.height);
+  const FloatExp pixel_size = FloatExp(2.0 / min_dim) / view.scale;
+  CpuKernelStats stats;
+
+  struct Pixel {
+    FloatExp dcx;
+    FloatExp dcy;
+    // dz = 2^k w and dc = 2^k u
+    int k = 0;
+    double s = 1.0;
+    double ux = 0.0, uy = 0.0;
+    double wx = 0.0, wy = 0.0;
+    // dz/dc = 2^j v
+    int j = 0;
+    double inv_j = 1.0;
+    double vx = 0.0, vy = 0.0;
+    double r2 = 0.0;
+    int n = 0, m = 0, steps = 0;
+    bool done = false;
+    bool glitched = false;
+  };
+  std::vector<Pixel> pixels(end - begin);
+  for (int i = begin; i < end; ++i) {
+    Pixel &pixel = pixels[i - begin];
+    int p = view.pixels ? view.pixels[i] : i;
+    int px = p % view.width;
+    int py = p / view.width;
+    FloatExp dcx =
+        view.reference_dx + pixel_size * (px + 0.5 - 0.5 * view.width);
+    FloatExp dcy =
+        view.reference_dy + pixel_size * (py + 0.5 - 0.5 * view.height);
+    pixel.dcx = dcx;
+    pixel.dcy = dcy;
+    pixel.k = dcx.mantissa == 0.0   ? dcy.exponent
+              : dcy.mantissa == 0.0 ? dcx.exponent
+                                    : std::max(dcx.exponent, dcy.exponent);
+    pixel.s = std::ldexp(1.0, pixel.k);
+    pixel.ux = double(ldexp(dcx, -pixel.k));
+    pixel.uy = double(ldexp(dcy, -pixel.k));
+  }
+
+  OrbitReader orbit(reference, view.reference_windows);
+  // Until the pixel finishes or needs another window
+  auto advance = [&](Pixel &pixel) {
+    Pixel q = pixel;
+    while (q.m >= orbit.begin && q.m < orbit.end) {
+      int i = q.m - orbit.begin;
+      double dzx = q.s * q.wx, dzy = q.s * q.wy;
+      double zx = orbit.x[i] + dzx;
+      double zy = orbit.y[i] + dzy;
+      q.r2 = zx * zx + zy * zy;
+      if (q.r2 > LIMIT || q.n == view.iterations) {
+        q.done = true;
+        break;
+      }
+      if (q.m == reference_end && reference.escaped && view.glitches) {
+        q.glitched = q.done = true;
+        break;
+      }
+      if (q.r2 < dzx * dzx + dzy * dzy || q.m == reference_end) {
+        // dz = z, with Z_0 = 0. Here |Z| <= 2|dz| unless the reference
+        // escaped, so the sum stays in range.
+        q.wx += std::ldexp(orbit.x[i], -q.k);
+        q.wy += std::ldexp(orbit.y[i], -q.k);
+        q.m = 0;
+      }
+      if (q.wx * q.wx + q.wy * q.wy > 0x1p128) {
+        int e = std::ilogb(std::max(std::abs(q.wx), std::abs(q.wy)));
+        q.wx = std::ldexp(q.wx, -e);
+        q.wy = std::ldexp(q.wy, -e);
+        q.k += e;
+        q.s = std::ldexp(1.0, q.k);
+        q.ux = double(ldexp(q.dcx, -q.k));
+        q.uy = double(ldexp(q.dcy, -q.k));
+      }
+      if constexpr (Distance) {
+        if (q.vx * q.vx + q.vy * q.vy > 0x1p128) {
+          int e = std::ilogb(std::max(std::abs(q.vx), std::abs(q.vy)));
+          q.vx = std::ldexp(q.vx, -e);
+          q.vy = std::ldexp(q.vy, -e);
+          q.j += e;
+          q.inv_j = std::ldexp(1.0, -q.j);
+        }
+      }
+      if (q.m < orbit.begin) {
+        break;
+      }
+      const Bla *skip = nullptr;
+      int length = 0;
+      if (bla && q.m > 0) {
+        // Radii only shrink with the length, so the search stops at the
+        // first level that does not hold. Level l starts at the multiples
+        // of 2^l after m = 1.
+        double w2 = q.wx * q.wx + q.wy * q.wy;
+        int offset = q.m - 1;
+        for (std::size_t level = 0; level < bla->levels.size(); ++level) {
+          int l = bla->first_level + int(level);
+          if ((offset & ((1 << l) - 1)) != 0 ||
+              std::size_t(offset >> l) >= bla->levels[level].size() ||
+              q.n + (1 << l) > view.iterations) {
+            break;
+          }
+          const Bla &b = bla->levels[level][offset >> l];
+          double r = std::ldexp(b.radius.mantissa, b.radius.exponent - q.k);
+          if (!(w2 < r * r)) {
+            break;
+          }
+          skip = &b;
+          length = 1 << l;
+        }
+      }
+      if (skip) {
+        if constexpr (Distance) {
+          double nvx = skip->ax * q.vx - skip->ay * q.vy + skip->bx * q.inv_j;
+          double nvy = skip->ax * q.vy + skip->ay * q.vx + skip->by * q.inv_j;
+          q.vx = nvx;
+          q.vy = nvy;
+        }
+        double nwx = skip->ax * q.wx - skip->ay * q.wy + skip->bx * q.ux -
+                     skip->by * q.uy;
+        double nwy = skip->ax * q.wy + skip->ay * q.wx + skip->bx * q.uy +
+                     skip->by * q.ux;
+        q.wx = nwx;
+        q.wy = nwy;
+        q.n += length;
+        q.m += length;
+      } else {
+        if constexpr (Distance) {
+          double nvx = 2.0 * (zx * q.vx - zy * q.vy) + q.inv_j;
+          double nvy = 2.0 * (zx * q.vy + zy * q.vx);
+          q.vx = nvx;
+          q.vy = nvy;
+        }
+        i = q.m - orbit.begin;
+        double tx = 2.0 * orbit.x[i] + q.s * q.wx;
+        double ty = 2.0 * orbit.y[i] + q.s * q.wy;
+        double nwx = tx * q.wx - ty * q.wy + q.ux;
+        double nwy = tx * q.wy + ty * q.wx + q.uy;
+        q.wx = nwx;
+        q.wy = nwy;
+        ++q.n;
+        ++q.m;
+      }
+      ++q.steps;
+    }
+    pixel = q;
+    return q.done;
+  };
+  int running = end - begin;
+  while (running > 0) {
+    int window = reference.size();
+    for (const Pixel &pixel : pixels) {
+      if (!pixel.done) {
+        window = std::min(window, orbit.window_of(pixel.m));
+      }
+    }
+    orbit.load(window);
+    for (Pixel &pixel : pixels) {
+      if (!pixel.done && orbit.window_of(pixel.m) == window) {
+        running -= advance(pixel);
+      }
+    }
+  }
+  stats.regenerated = orbit.regenerated;
+
+  for (int i = begin; i < end; ++i) {
+    const Pixel &pixel = pixels[i - begin];
+    int p = view.pixels ? view.pixels[i] : i;
+    float *result = out + 4 * std::size_t(p);
+    stats.active_steps += pixel.steps;
+    stats.lane_steps += pixel.steps;
+    stats.iterations += pixel.n;
+    if (view.glitches) {
+      view.glitches[p] = pixel.glitched;
+    }
+    if (pixel.r2 <= LIMIT || pixel.glitched) {
+      std::fill(result, result + 4, 0.0f);
+      continue;
+    }
+    double log_r = 0.5 * std::log(pixel.r2);
+    double de = 0.0;
+    if constexpr (Distance) {
+      // In pixels, |dz/dc| / pixel_size
+      double dr = std::sqrt(pixel.vx * pixel.vx + pixel.vy * pixel.vy);
+      de = double(FloatExp(0.5 * std::sqrt(pixel.r2) / dr * log_r, -pixel.j) /
+                  pixel_size);
+    }
+    result[0] = std::max(pixel.n - std::log(log_r) / std::log(2.0), 0.0);
+    result[1] = de;
+    result[2] = 1.0f;
+    result[3] = 0.0f;
+  }
+  return stats;
+}
+
+template <VariantFormula F, bool Julia, bool Distance, int... Powers>
+CpuKernel select_power(int power, std::integer_sequence<int, Powers...>) {
+  static constexpr CpuKernel table[] = {
+      render_pixels<double, F, Powers + CPU_MIN_POWER, Julia, Distance>...};
+  return table[power - CPU_MIN_POWER];
+}
+
+template <VariantFormula F, bool Julia, bool Distance>
+CpuKernel select_power(int power) {
+  return select_power<F, Julia, Distance>(
+      power, std::make_integer_sequence<int, CPU_MAX_POWER - CPU_MIN_POWER +
+                                                 1>{});
+}
+
+#ifdef CPU_KERNELS_AVX2
+// The kernel is inlined here and compiled for AVX2, where the exact products
+// of the double-double arithmetic are single FMA instructions
+template <VariantFormula F, bool Julia, bool Distance>
+__attribute__((target("avx2,fma"))) CpuKernelStats
+render_pixels_avx2(const CpuView &view, int begin, int end, float *out) {
+  return render_pixels<DoubleDoubleT<true>, F, 2, Julia, Distance>(
+      view, begin, end, out);
+}
+
+inline bool has_avx2_fma() {
+  static const bool supported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+}
+#else
+inline bool has_avx2_fma() { return false; }
+#endif
+
+template <VariantFormula F, bool Julia, bool Distance>
+CpuKernel select_precision(int power, CpuPrecision precision) {
+  if constexpr (F == FORMULA_MANDELBROT && !Julia) {
+    if (precision == CPU_PRECISION_PERTURBATION) {
+      return render_pixels_perturbation<Distance>;
+    }
+  }
+  if (precision == CPU_PRECISION_DOUBLE) {
+    return select_power<F, Julia, Distance>(power);
+  }
+  if (precision == CPU_PRECISION_FIXED) {
+    return render_pixels<Fixed, F, 2, Julia, Distance>;
+  }
+#ifdef CPU_KERNELS_AVX2
+  if (has_avx2_fma()) {
+    return render_pixels_avx2<F, Julia, Distance>;
+  }
+#endif
+  return render_pixels<DoubleDouble, F, 2, Julia, Distance>;
+}
+
+template <VariantFormula F>
+CpuKernel select_modes(int power, bool julia, bool distance,
+                       CpuPrecision precision) {
+  if (julia) {
+    return distance ? select_precision<F, true, true>(power, precision)
+                    : select_precision<F, true, false>(power, precision);
+  }
+  return distance ? select_precision<F, false, true>(power, precision)
+                  : select_precision<F, false, false>(power, precision);
+}
+
+} // namespace cpu_kernels
+
+// power is clamped to [CPU_MIN_POWER, CPU_MAX_POWER] and precision to what
+// the settings support
+inline CpuKernel select_cpu_kernel(VariantFormula formula, int power,
+                                   bool julia, bool distance,
+                                   CpuPrecision precision) {
+  using namespace cpu_kernels;
+  power = std::max(CPU_MIN_POWER, std::min(CPU_MAX_POWER, power));
+  precision = supported_cpu_precision(precision, formula, power, julia);
+  switch (formula) {
+  case FORMULA_BURNING_SHIP:
+    return select_modes<FORMULA_BURNING_SHIP>(power, julia, distance,
+                                              precision);
+  case FORMULA_TRICORN:
+    return select_modes<FORMULA_TRICORN>(power, julia, distance, precision);
+  default:
+    return select_modes<FORMULA_MANDELBROT>(power, julia, distance,
+                                            precision);
+  }
+}
+
+#endif // cpu_kernels_hpp_INCLUDED
@@ -0,0 +1,124 @@
+#ifndef double_double_hpp_INCLUDED
+#define double_double_hpp_INCLUDED
+
+#include <cmath>
+
+// Unevaluated sum hi + lo of two doubles with |lo| <= ulp(hi) / 2, which
+// carries about 106 significant bits. The exact products come from fused
+// multiply-add with Fma, only worth it where the target has the instruction,
+// and from Dekker's splitting otherwise.
+template <bool Fma> struct DoubleDoubleT {
+  double hi = 0.0;
+  double lo = 0.0;
+
+  constexpr DoubleDoubleT() = default;
+  constexpr DoubleDoubleT(double hi, double lo = 0.0) : hi(hi), lo(lo) {}
+  template <bool OtherFma>
+  explicit constexpr DoubleDoubleT(DoubleDoubleT<OtherFma> other)
+      : hi(other.hi), lo(other.lo) {}
+
+  // s + error = a + b exactly
+  static DoubleDoubleT two_sum(double a, double b) noexcept {
+    double s = a + b;
+    double bb = s - a;
+    return {s, (a - (s - bb)) + (b - bb)};
+  }
+
+  // Same, given |a| >= |b|
+  static DoubleDoubleT quick_two_sum(double a, double b) noexcept {
+    double s = a + b;
+    return {s, b - (s - a)};
+  }
+
+  // p + error = a * b exactly
+  static DoubleDoubleT two_prod(double a, double b) noexcept {
+    double p = a * b;
+    if constexpr (Fma) {
+      return {p, std::fma(a, b, -p)};
+    } else {
+      constexpr double SPLIT = 134217729.0; // 2^27 + 1
+      double ta = SPLIT * a;
+      double ah = ta - (ta - a);
+      double al = a - ah;
+      double tb = SPLIT * b;
+      double bh = tb - (tb - b);
+      double bl = b - bh;
+      return {p, ((ah * bh - p) + ah * bl + al * bh) + al * bl};
+    }
+  }
+
+  DoubleDoubleT operator-() const noexcept { return {-hi, -lo}; }
+
+  friend DoubleDoubleT operator+(DoubleDoubleT a, DoubleDoubleT b) noexcept {
+    DoubleDoubleT s = two_sum(a.hi, b.hi);
+    DoubleDoubleT t = two_sum(a.lo, b.lo);
+    s = quick_two_sum(s.hi, s.lo + t.hi);
+    return quick_two_sum(s.hi, s.lo + t.lo);
+  }
+
+  friend DoubleDoubleT operator+(DoubleDoubleT a, double b) noexcept {
+    DoubleDoubleT s = two_sum(a.hi, b);
+    return quick_two_sum(s.hi, s.lo + a.lo);
+  }
+
+  friend DoubleDoubleT operator+(double a, DoubleDoubleT b) noexcept {
+    return b + a;
+  }
+
+  friend DoubleDoubleT operator-(DoubleDoubleT a, DoubleDoubleT b) noexcept {
+    return a + -b;
+  }
+
+  friend DoubleDoubleT operator-(DoubleDoubleT a, double b) noexcept {
+    return a + -b;
+  }
+
+  friend DoubleDoubleT operator*(DoubleDoubleT a, DoubleDoubleT b) noexcept {
+    DoubleDoubleT p = two_prod(a.hi, b.hi);
+    return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+  }
+
+  friend DoubleDoubleT operator*(DoubleDoubleT a, double b) noexcept {
+    DoubleDoubleT p = two_prod(a.hi, b);
+    return quick_two_sum(p.hi, p.lo + a.lo * b);
+  }
+
+  friend DoubleDoubleT operator*(double a, DoubleDoubleT b) noexcept {
+    return b * a;
+  }
+
+  friend DoubleDoubleT operator/(DoubleDoubleT a, double b) noexcept {
+    double q = a.hi / b;
+    DoubleDoubleT r = a - two_prod(q, b);
+    return quick_two_sum(q, (r.hi + r.lo) / b);
+  }
+
+  friend DoubleDoubleT operator/(DoubleDoubleT a, DoubleDoubleT b) noexcept {
+    double q = a.hi / b.hi;
+    DoubleDoubleT r = a - b * q;
+    return quick_two_sum(q, r.hi / b.hi);
+  }
+
+  friend bool operator==(DoubleDoubleT a, DoubleDoubleT b) noexcept {
+    return a.hi == b.hi && a.lo == b.lo;
+  }
+
+  friend bool operator!=(DoubleDoubleT a, DoubleDoubleT b) noexcept {
+    return !(a == b);
+  }
+
+  friend DoubleDoubleT abs(DoubleDoubleT a) noexcept {
+    return a.hi < 0.0 ? -a : a;
+  }
+};
+
+using DoubleDouble = DoubleDoubleT<false>;
+
+// Nearest double, lets code be written for any floating-point type
+template <typename T> double to_double(T x) noexcept { return double(x); }
+
+template <bool Fma> double to_double(DoubleDoubleT<Fma> x) noexcept {
+  return x.hi;
+}
+
+#endif // double_double_hpp_INCLUDED
@@ -0,0 +1,80 @@
+#ifndef fixed_point_hpp_INCLUDED
+#define fixed_point_hpp_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+
+// Full 128-bit product hi:lo of two 64-bit integers
+inline void multiply_wide(std::uint64_t a, std::uint64_t b, std::uint64_t &hi,
+                          std::uint64_t &lo) noexcept {
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 product = (unsigned __int128)a * b;
+  hi = std::uint64_t(product >> 64);
+  lo = std::uint64_t(product);
+#else
+  // In 32-bit halves
+  std::uint64_t a0 = a & 0xffffffff, a1 = a >> 32;
+  std::uint64_t b0 = b & 0xffffffff, b1 = b >> 32;
+  std::uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0;
+  std::uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+  lo = (p00 & 0xffffffff) | (mid << 32);
+  hi = a1 * b1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+}
+
+// Signed Q3.60 fixed point: values in [-8, 8) in steps of 2^-60, which is
+// 8 bits finer than a double between 1 and 2 and only needs integer
+// arithmetic. Nothing is checked for overflow, callers keep the values in
+// range.
+struct Fixed {
+  static constexpr int FRACTION_BITS = 60;
+
+  std::int64_t raw = 0;
+
+  constexpr Fixed() = default;
+  Fixed(double value) : raw(std::llrint(value * 0x1p60)) {}
+
+  static constexpr Fixed from_raw(std::int64_t raw) noexcept {
+    Fixed result;
+    result.raw = raw;
+    return result;
+  }
+
+  explicit operator double() const noexcept { return raw * 0x1p-60; }
+
+  // Rounded (a * b) >> FRACTION_BITS, from the full 128-bit product
+  static std::int64_t multiply(std::int64_t a, std::int64_t b) noexcept {
+    constexpr int SHIFT = FRACTION_BITS;
+#ifdef __SIZEOF_INT128__
+    __int128 product = __int128(a) * b;
+    return std::int64_t((product + (__int128(1) << (SHIFT - 1))) >> SHIFT);
+#else
+    bool negative = (a < 0) != (b < 0);
+    std::uint64_t hi, lo;
+    multiply_wide(a < 0 ? 0 - std::uint64_t(a) : std::uint64_t(a),
+                  b < 0 ? 0 - std::uint64_t(b) : std::uint64_t(b), hi, lo);
+    std::uint64_t rounded = lo + (std::uint64_t(1) << (SHIFT - 1));
+    hi += rounded < lo;
+    std::uint64_t q = (hi << (64 - SHIFT)) | (rounded >> SHIFT);
+    return negative ? -std::int64_t(q) : std::int64_t(q);
+#endif
+  }
+
+  Fixed operator-() const noexcept { return from_raw(-raw); }
+
+  friend Fixed operator+(Fixed a, Fixed b) noexcept {
+    return from_raw(a.raw + b.raw);
+  }
+
+  friend Fixed operator-(Fixed a, Fixed b) noexcept {
+    return from_raw(a.raw - b.raw);
+  }
+
+  friend Fixed operator*(Fixed a, Fixed b) noexcept {
+    return from_raw(multiply(a.raw, b.raw));
+  }
+
+  friend Fixed abs(Fixed a) noexcept { return a.raw < 0 ? -a : a; }
+};
+
+#endif // fixed_point_hpp_INCLUDED
@@ -0,0 +1,89 @@
+#ifndef float_exp_hpp_INCLUDED
+#define float_exp_hpp_INCLUDED
+
+#include <cmath>
+
+// Double mantissa with a separate int exponent, for magnitudes far outside
+// the range of a double such as the scale and pixel size of deep zooms. The
+// mantissa is 0 or in [0.5, 1) in magnitude. Operations renormalize with
+// frexp and have no other branches than the alignment of sums.
+struct FloatExp {
+  double mantissa = 0.0;
+  int exponent = 0;
+
+  constexpr FloatExp() = default;
+  FloatExp(double value) noexcept { mantissa = std::frexp(value, &exponent); }
+  FloatExp(double mantissa, int exponent) noexcept : FloatExp(mantissa) {
+    this->exponent += exponent;
+    if (this->mantissa == 0.0) {
+      this->exponent = 0;
+    }
+  }
+
+  // 0 and infinity where the value is out of range of a double
+  explicit operator double() const noexcept {
+    return std::ldexp(mantissa, exponent);
+  }
+
+  FloatExp operator-() const noexcept { return {-mantissa, exponent}; }
+
+  friend FloatExp operator*(FloatExp a, FloatExp b) noexcept {
+    return {a.mantissa * b.mantissa, a.exponent + b.exponent};
+  }
+
+  friend FloatExp operator/(FloatExp a, FloatExp b) noexcept {
+    return {a.mantissa / b.mantissa, a.exponent - b.exponent};
+  }
+
+  friend FloatExp operator+(FloatExp a, FloatExp b) noexcept {
+    if (a.mantissa == 0.0) {
+      return b;
+    }
+    if (b.mantissa == 0.0) {
+      return a;
+    }
+    // Beyond 64 bits apart the smaller one does not reach the sum
+    int shift = a.exponent - b.exponent;
+    if (shift > 64) {
+      return a;
+    }
+    if (shift < -64) {
+      return b;
+    }
+    return shift >= 0
+               ? FloatExp(a.mantissa + std::ldexp(b.mantissa, -shift),
+                          a.exponent)
+               : FloatExp(std::ldexp(a.mantissa, shift) + b.mantissa,
+                          b.exponent);
+  }
+
+  friend FloatExp operator-(FloatExp a, FloatExp b) noexcept {
+    return a + -b;
+  }
+
+  friend bool operator==(FloatExp a, FloatExp b) noexcept {
+    return a.mantissa == b.mantissa && a.exponent == b.exponent;
+  }
+
+  friend bool operator!=(FloatExp a, FloatExp b) noexcept {
+    return !(a == b);
+  }
+
+  friend bool operator<(FloatExp a, FloatExp b) noexcept {
+    return (a - b).mantissa < 0.0;
+  }
+
+  friend FloatExp abs(FloatExp a) noexcept {
+    return {std::abs(a.mantissa), a.exponent};
+  }
+
+  friend FloatExp ldexp(FloatExp a, int exponent) noexcept {
+    return {a.mantissa, a.exponent + exponent};
+  }
+
+  friend double log2(FloatExp a) noexcept {
+    return std::log2(std::abs(a.mantissa)) + a.exponent;
+  }
+};
+
+#endif // float_exp_hpp_INCLUDED
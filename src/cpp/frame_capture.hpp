@@ -0,0 +1,183 @@
+#ifndef frame_capture_hpp_INCLUDED
+#define frame_capture_hpp_INCLUDED
+
+#include "gl.hpp"
+
+#include <SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads frames back without stalling the pipeline. glReadPixels into a pack
+// buffer only queues the copy; the buffer is mapped a frame or two later,
+// once its fence has signaled, and an encoder thread writes the pixels out
+// as binary PPM. Frames are dropped rather than waited for when the GPU or
+// the encoder falls behind.
+struct FrameCapture {
+  static constexpr int RING_SIZE = 3;
+  static constexpr std::size_t MAX_QUEUED = 8;
+
+  FrameCapture() {
+    for (Slot &slot : slots) {
+      glGenBuffers(1, &slot.buffer);
+    }
+    encoder = std::thread([this] { run(); });
+  }
+
+  ~FrameCapture() {
+    for (Slot &slot : slots) {
+      if (slot.fence) {
+        glDeleteSync(slot.fence);
+      }
+      glDeleteBuffers(1, &slot.buffer);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    wake.notify_one();
+    encoder.join();
+  }
+
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  // Starts reading the bound read framebuffer, saved as path once it arrives
+  void read(int width, int height, std::string path) {
+    Slot &slot = slots[next];
+    if (slot.fence) {
+      ++dropped;
+      return;
+    }
+    GLsizeiptr size = GLsizeiptr(4) * width * height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+      glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+      slot.capacity = size;
+    }
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.path = std::move(path);
+    next = (next + 1) % RING_SIZE;
+  }
+
+  // Hands the finished reads to the encoder, oldest first, never waits
+  void collect() {
+    for (int i = 0; i < RING_SIZE; ++i) {
+      Slot &slot = slots[(next + i) % RING_SIZE];
+      if (!slot.fence) {
+        continue;
+      }
+      if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        return;
+      }
+      glDeleteSync(slot.fence);
+      slot.fence = nullptr;
+
+      Image image{slot.path, slot.width, slot.height, {}};
+      std::size_t size = std::size_t(4) * slot.width * slot.height;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+      const void *pixels =
+          glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+      if (pixels) {
+        image.pixels.resize(size);
+        std::memcpy(image.pixels.data(), pixels, size);
+      }
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      if (!pixels) {
+        SDL_Log("Could not map the pixel buffer of %s", slot.path.c_str());
+        ++dropped;
+        continue;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (queue.size() >= MAX_QUEUED) {
+        ++dropped;
+        continue;
+      }
+      queue.push_back(std::move(image));
+      wake.notify_one();
+    }
+  }
+
+  unsigned written() const noexcept { return written_count; }
+  // Only read and modified on the GL thread
+  unsigned dropped = 0;
+
+private:
+  struct Slot {
+    GLuint buffer = 0;
+    GLsizeiptr capacity = 0;
+    GLsync fence = nullptr;
+    int width = 0;
+    int height = 0;
+    std::string path;
+  };
+
+  // Tightly packed RGBA8, bottom row first
+  struct Image {
+    std::string path;
+    int width;
+    int height;
+    std::vector<std::uint8_t> pixels;
+  };
+
+  Slot slots[RING_SIZE];
+  int next = 0;
+
+  std::thread encoder;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Image> queue;
+  bool stop = false;
+  std::atomic<unsigned> written_count = 0;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this] { return stop || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      Image image = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      if (write_ppm(image)) {
+        ++written_count;
+      }
+      lock.lock();
+    }
+  }
+
+  static bool write_ppm(const Image &image) {
+    std::FILE *file = std::fopen(image.path.c_str(), "wb");
+    if (!file) {
+      SDL_Log("Could not write %s", image.path.c_str());
+      return false;
+    }
+    std::fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    std::vector<std::uint8_t> row(3 * image.width);
+    for (int y = image.height - 1; y >= 0; --y) {
+      const std::uint8_t *src =
+          &image.pixels[std::size_t(4) * image.width * y];
+      for (int x = 0; x < image.width; ++x) {
+        std::memcpy(&row[3 * x], &src[4 * x], 3);
+      }
+      std::fwrite(row.data(), 1, row.size(), file);
+    }
+    return std::fclose(file) == 0;
+  }
+};
+
+#endif // frame_capture_hpp_INCLUDED
@@ -2,22 +2,63 @@
 #define gl_hpp_INCLUDED
 
 #include <SDL.h>
+#include <array>
+#include <cstdint>
 #include <cstring>
 #include <glad/gl.h>
+#include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-enum BufferId { BUF_ID_VERTEX = 0, BUF_ID_INDEX, BUF_TOTAL };
-enum VaoId { VAO_ID_FULLSCREEN = 0, VAO_TOTAL };
+enum BufferId {
+  BUF_ID_VERTEX = 0,
+  BUF_ID_INDEX,
+  BUF_ID_VIEW,
+  BUF_ID_PIXEL_STATES,
+  BUF_ID_PIXEL_LIST_0,
+  BUF_ID_PIXEL_LIST_1,
+  BUF_ID_PASS_COUNTERS,
+  BUF_ID_PASS_STATS,
+  BUF_TOTAL
+};
+enum VaoId { VAO_ID_FULLSCREEN = 0, VAO_ID_EMPTY, VAO_TOTAL };
+enum TextureId {
+  TEX_ID_ITERATIONS = 0,
+  TEX_ID_AA_ITERATIONS,
+  TEX_ID_PALETTE,
+  TEX_ID_HISTOGRAM,
+  TEX_ID_CDF_0,
+  TEX_ID_CDF_1,
+  TEX_ID_ITERATION_RANGE,
+  TEX_TOTAL
+};
+enum FramebufferId {
+  FBO_ID_ITERATIONS = 0,
+  FBO_ID_AA_ITERATIONS,
+  FBO_ID_HISTOGRAM,
+  FBO_ID_CDF_0,
+  FBO_ID_CDF_1,
+  FBO_ID_ITERATION_RANGE,
+  FBO_TOTAL
+};
+enum QueryId { QUERY_ID_HISTOGRAM = 0, QUERY_ID_AA_PIXELS, QUERY_TOTAL };
 
 struct RAII_GL {
   RAII_GL() {
     gladLoadGL((GLADloadfunc)SDL_GL_GetProcAddress);
     glGenBuffers(BUF_TOTAL, buf);
     glGenVertexArrays(VAO_TOTAL, vao);
+    glGenTextures(TEX_TOTAL, tex);
+    glGenFramebuffers(FBO_TOTAL, fbo);
+    glGenQueries(QUERY_TOTAL, query);
   }
 
   ~RAII_GL() {
+    glDeleteQueries(QUERY_TOTAL, query);
+    glDeleteFramebuffers(FBO_TOTAL, fbo);
+    glDeleteTextures(TEX_TOTAL, tex);
     glDeleteVertexArrays(VAO_TOTAL, vao);
     glDeleteBuffers(BUF_TOTAL, buf);
   }
@@ -27,17 +68,35 @@ struct RAII_GL {
 
   GLuint buf_id(BufferId id) const noexcept { return buf[id]; }
   GLuint vao_id(VaoId id) const noexcept { return vao[id]; }
+  GLuint tex_id(TextureId id) const noexcept { return tex[id]; }
+  GLuint fbo_id(FramebufferId id) const noexcept { return fbo[id]; }
+  GLuint query_id(QueryId id) const noexcept { return query[id]; }
 
 private:
   GLuint buf[BUF_TOTAL];
   GLuint vao[VAO_TOTAL];
+  GLuint tex[TEX_TOTAL];
+  GLuint fbo[FBO_TOTAL];
+  GLuint query[QUERY_TOTAL];
 };
 
 struct Shader {
-  Shader(GLenum type, const char *source) : idx(glCreateShader(type)) {
-    const GLchar *source_data[] = {source};
-    const GLint source_length[] = {static_cast<GLint>(std::strlen(source))};
-    glShaderSource(idx, 1, source_data, source_length);
+  // Optional defines are injected right after the #version line, which is
+  // replaced by version if given
+  Shader(GLenum type, const char *source, const char *defines = nullptr,
+         const char *version = nullptr)
+      : idx(glCreateShader(type)) {
+    const char *body = std::strchr(source, '\n');
+    body = body && (defines || version) ? body + 1
+                                        : source + std::strlen(source);
+    const char *head = version ? version : source;
+    const GLchar *source_data[] = {head, defines ? defines : "", body};
+    const GLint source_length[] = {
+        static_cast<GLint>(version ? std::strlen(version) : body - source),
+        static_cast<GLint>(defines ? std::strlen(defines) : 0),
+        static_cast<GLint>(std::strlen(body)),
+    };
+    glShaderSource(idx, 3, source_data, source_length);
     glCompileShader(idx);
 
     GLint log_length;
@@ -48,6 +107,9 @@ struct Shader {
     SDL_Log(
         "Compiling shader with source:\n////////////////\n%s\n////////////////",
         source);
+    if (defines) {
+      SDL_Log("With defines:\n%s", defines);
+    }
     SDL_Log("Shader compilation log:\n%s", log.data());
   }
 
@@ -65,11 +127,58 @@ private:
 
 struct ShaderProgram {
   ShaderProgram() : idx(glCreateProgram()) {}
+
+  struct Source {
+    GLenum type;
+    const char *source;
+    const char *defines = nullptr;
+    const char *version = nullptr;
+  };
+
+  ShaderProgram(const std::vector<Source> &sources) : ShaderProgram() {
+    link(sources);
+  }
+
   ~ShaderProgram() { glDeleteProgram(idx); }
 
   ShaderProgram(const ShaderProgram &) = delete;
   ShaderProgram &operator=(const ShaderProgram &) = delete;
 
+  ShaderProgram(ShaderProgram &&other) noexcept : idx(other.idx) {
+    other.idx = 0;
+  }
+
+  ShaderProgram &operator=(ShaderProgram &&other) noexcept {
+    std::swap(idx, other.idx);
+    return *this;
+  }
+
+  // Several sources of the same type are compiled as separate shader objects
+  // and linked together, which is how shared GLSL functions are reused
+  void link(const std::vector<Source> &sources) {
+    std::vector<std::unique_ptr<Shader>> shaders;
+    for (const Source &src : sources) {
+      shaders.push_back(
+          std::make_unique<Shader>(src.type, src.source, src.defines,
+                                   src.version));
+      glAttachShader(idx, *shaders.back());
+    }
+    glLinkProgram(idx);
+
+    GLint log_length;
+    glGetProgramiv(idx, GL_INFO_LOG_LENGTH, &log_length);
+
+    std::vector<GLchar> info_log(log_length);
+    glGetProgramInfoLog(idx, info_log.size(), nullptr, info_log.data());
+    SDL_Log("Program linking log:\n%s", info_log.data());
+  }
+
+  bool is_linked() const noexcept {
+    GLint status;
+    glGetProgramiv(idx, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+  }
+
   GLuint get() const noexcept { return idx; }
   operator GLuint() const noexcept { return get(); }
 
@@ -77,4 +186,180 @@ private:
   GLuint idx;
 };
 
+// Remembers bindings and uniform values to skip calls that would not change
+// anything, which is measurable on software implementations. Only correct
+// while every such change goes through it; after anything else touches the
+// state, call invalidate(). ImGui restores what it changes, so it is fine.
+struct GLStateCache {
+  static constexpr int TEXTURE_UNITS = 4;
+
+  // Calls made and skipped during the previous frame
+  unsigned frame_issued = 0;
+  unsigned frame_elided = 0;
+
+  void next_frame() noexcept {
+    frame_issued = issued;
+    frame_elided = elided;
+    issued = 0;
+    elided = 0;
+  }
+
+  void invalidate() noexcept {
+    program = UNKNOWN;
+    vertex_array = UNKNOWN;
+    read_framebuffer = UNKNOWN;
+    draw_framebuffer = UNKNOWN;
+    active_unit = UNKNOWN;
+    for (auto &unit : textures) {
+      unit.fill(UNKNOWN);
+    }
+    blend = UNKNOWN;
+    viewport_rect.fill(UNKNOWN);
+    uniforms.clear();
+  }
+
+  void use_program(GLuint id) {
+    if (changed(program, id)) {
+      glUseProgram(id);
+    }
+  }
+
+  void bind_vertex_array(GLuint id) {
+    if (changed(vertex_array, id)) {
+      glBindVertexArray(id);
+    }
+  }
+
+  // GL_FRAMEBUFFER binds both the read and the draw framebuffer
+  void bind_framebuffer(GLenum target, GLuint id) {
+    bool read = target != GL_DRAW_FRAMEBUFFER && read_framebuffer != id;
+    bool draw = target != GL_READ_FRAMEBUFFER && draw_framebuffer != id;
+    if (!read && !draw) {
+      ++elided;
+      return;
+    }
+    ++issued;
+    if (read && draw) {
+      target = GL_FRAMEBUFFER;
+    } else {
+      target = read ? GL_READ_FRAMEBUFFER : GL_DRAW_FRAMEBUFFER;
+    }
+    glBindFramebuffer(target, id);
+    read_framebuffer = read ? id : read_framebuffer;
+    draw_framebuffer = draw ? id : draw_framebuffer;
+  }
+
+  // Only 1D and 2D textures are tracked
+  void bind_texture(GLuint unit, GLenum target, GLuint id) {
+    if (changed(textures[unit][target == GL_TEXTURE_1D ? 0 : 1], id)) {
+      if (changed(active_unit, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+      }
+      glBindTexture(target, id);
+    }
+  }
+
+  // Binds a texture that glTex* calls then modify. Those act on the active
+  // unit, which bind_texture leaves alone where the texture is already
+  // bound, so the unit is selected either way.
+  void bind_texture_for_edit(GLuint unit, GLenum target, GLuint id) {
+    if (changed(active_unit, unit)) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    bind_texture(unit, target, id);
+  }
+
+  void set_blend(bool enabled) {
+    if (changed(blend, enabled)) {
+      enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+    }
+  }
+
+  void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    std::array<GLuint, 4> rect = {GLuint(x), GLuint(y), GLuint(width),
+                                  GLuint(height)};
+    if (changed(viewport_rect, rect)) {
+      glViewport(x, y, width, height);
+    }
+  }
+
+  // Uniform setters for the current program. Locations of inactive uniforms
+  // are -1 and ignored, as GL does.
+  void uniform(GLint location, GLint v0) {
+    if (changed_uniform(location, {GLuint(v0)})) {
+      glUniform1i(location, v0);
+    }
+  }
+
+  void uniform(GLint location, GLint v0, GLint v1) {
+    if (changed_uniform(location, {GLuint(v0), GLuint(v1)})) {
+      glUniform2i(location, v0, v1);
+    }
+  }
+
+  void uniform(GLint location, GLfloat v0) {
+    if (changed_uniform(location, {bits(v0)})) {
+      glUniform1f(location, v0);
+    }
+  }
+
+  void uniform(GLint location, GLfloat v0, GLfloat v1) {
+    if (changed_uniform(location, {bits(v0), bits(v1)})) {
+      glUniform2f(location, v0, v1);
+    }
+  }
+
+private:
+  static constexpr GLuint UNKNOWN = ~GLuint(0);
+
+  unsigned issued = 0;
+  unsigned elided = 0;
+  GLuint program = UNKNOWN;
+  GLuint vertex_array = UNKNOWN;
+  GLuint read_framebuffer = UNKNOWN;
+  GLuint draw_framebuffer = UNKNOWN;
+  GLuint active_unit = UNKNOWN;
+  // 1D and 2D bindings per unit
+  std::array<GLuint, 2> textures[TEXTURE_UNITS] = {
+      {UNKNOWN, UNKNOWN}, {UNKNOWN, UNKNOWN},
+      {UNKNOWN, UNKNOWN}, {UNKNOWN, UNKNOWN}};
+  GLuint blend = UNKNOWN;
+  std::array<GLuint, 4> viewport_rect = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+  // Keyed by program and location, values are stored as raw bits
+  std::unordered_map<std::uint64_t, std::array<GLuint, 2>> uniforms;
+
+  static GLuint bits(GLfloat value) noexcept {
+    GLuint result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+  }
+
+  template <typename T> bool changed(T &cached, const T &value) noexcept {
+    if (cached == value) {
+      ++elided;
+      return false;
+    }
+    cached = value;
+    ++issued;
+    return true;
+  }
+
+  bool changed(GLuint &cached, bool value) noexcept {
+    return changed(cached, GLuint(value));
+  }
+
+  bool changed_uniform(GLint location, std::array<GLuint, 2> value) {
+    if (location < 0) {
+      return false;
+    }
+    std::uint64_t key = std::uint64_t(program) << 32 | GLuint(location);
+    auto [it, inserted] = uniforms.try_emplace(key, value);
+    if (inserted) {
+      ++issued;
+      return true;
+    }
+    return changed(it->second, value);
+  }
+};
+
 #endif // gl_hpp_INCLUDED
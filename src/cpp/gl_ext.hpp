@@ -0,0 +1,114 @@
+#ifndef gl_ext_hpp_INCLUDED
+#define gl_ext_hpp_INCLUDED
+
+#include <SDL.h>
+#include <algorithm>
+#include <glad/gl.h>
+
+// Entry points beyond the GL 3.3 core that the loader was generated for.
+// They are resolved at runtime and every feature has a flag telling whether
+// the driver supports it.
+
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_DISPATCH_INDIRECT_BUFFER 0x90EE
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#define GL_MAX_COMPUTE_WORK_GROUP_COUNT 0x91BE
+
+typedef void(GLAD_API_PTR *PFNGLGETPROGRAMBINARYPROC)(GLuint program,
+                                                     GLsizei bufSize,
+                                                     GLsizei *length,
+                                                     GLenum *binaryFormat,
+                                                     void *binary);
+typedef void(GLAD_API_PTR *PFNGLPROGRAMBINARYPROC)(GLuint program,
+                                                  GLenum binaryFormat,
+                                                  const void *binary,
+                                                  GLsizei length);
+typedef void(GLAD_API_PTR *PFNGLPROGRAMPARAMETERIPROC)(GLuint program,
+                                                      GLenum pname,
+                                                      GLint value);
+typedef void(GLAD_API_PTR *PFNGLBUFFERSTORAGEPROC)(GLenum target,
+                                                  GLsizeiptr size,
+                                                  const void *data,
+                                                  GLbitfield flags);
+typedef void(GLAD_API_PTR *PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x,
+                                                    GLuint num_groups_y,
+                                                    GLuint num_groups_z);
+typedef void(GLAD_API_PTR *PFNGLDISPATCHCOMPUTEINDIRECTPROC)(
+    GLintptr indirect);
+typedef void(GLAD_API_PTR *PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void(GLAD_API_PTR *PFNGLBINDIMAGETEXTUREPROC)(
+    GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer,
+    GLenum access, GLenum format);
+
+struct GLExtensions {
+  bool program_binary = false;
+  bool gpu_shader_fp64 = false;
+  bool buffer_storage = false;
+  // Compute shaders with shader storage buffers and image stores
+  bool compute_shader = false;
+  // Work groups a dispatch may have along x, at least 65535
+  GLuint max_compute_groups_x = 0;
+  PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+  PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+  PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+  PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+  PFNGLDISPATCHCOMPUTEPROC DispatchCompute = nullptr;
+  PFNGLDISPATCHCOMPUTEINDIRECTPROC DispatchComputeIndirect = nullptr;
+  PFNGLMEMORYBARRIERPROC MemoryBarrier = nullptr;
+  PFNGLBINDIMAGETEXTUREPROC BindImageTexture = nullptr;
+
+  GLExtensions() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    int version = 10 * major + minor;
+
+    if (version >= 41 ||
+        SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+      load(GetProgramBinary, "glGetProgramBinary");
+      load(ProgramBinary, "glProgramBinary");
+      load(ProgramParameteri, "glProgramParameteri");
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      program_binary =
+          GetProgramBinary && ProgramBinary && ProgramParameteri && formats > 0;
+    }
+
+    gpu_shader_fp64 =
+        version >= 40 || SDL_GL_ExtensionSupported("GL_ARB_gpu_shader_fp64");
+
+    if (version >= 44 || SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+      load(BufferStorage, "glBufferStorage");
+      buffer_storage = BufferStorage != nullptr;
+    }
+
+    // The shaders are GLSL 4.30, so the extensions alone are not enough
+    if (version >= 43) {
+      load(DispatchCompute, "glDispatchCompute");
+      load(DispatchComputeIndirect, "glDispatchComputeIndirect");
+      load(MemoryBarrier, "glMemoryBarrier");
+      load(BindImageTexture, "glBindImageTexture");
+      compute_shader = DispatchCompute && DispatchComputeIndirect &&
+                       MemoryBarrier && BindImageTexture;
+      GLint max_groups_x = 0;
+      glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &max_groups_x);
+      max_compute_groups_x = GLuint(std::max(max_groups_x, 65535));
+    }
+  }
+
+private:
+  template <typename F> static void load(F &f, const char *name) {
+    f = reinterpret_cast<F>(SDL_GL_GetProcAddress(name));
+  }
+};
+
+#endif // gl_ext_hpp_INCLUDED
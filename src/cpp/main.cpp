@@ -1,34 +1,109 @@
+#include "camera.hpp"
+#include "cpu_kernels.hpp"
+#include "frame_capture.hpp"
 #include "gl.hpp"
+#include "gl_ext.hpp"
+#include "nucleus.hpp"
+#include "palette.hpp"
+#include "program_cache.hpp"
 #include "raii.hpp"
-#include "shader_sources.hpp"
+#include "shaders.hpp"
+#include "texture_stream.hpp"
+#include "thread_pool.hpp"
+#include "triple_buffer.hpp"
+#ifdef SHADER_HOT_RELOAD_DIR
+#include "shader_reload.hpp"
+#endif
 
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <future>
 #include <imgui.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_sdl2.h>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 struct Game {
   RAII_SDL_System _system;
   PWindow window;
   PGLContext context;
   std::optional<RAII_GL> gl;
-  std::optional<ShaderProgram> shader_program;
+  std::optional<GLExtensions> gl_ext;
+  std::optional<ProgramCache> program_cache;
+  GLStateCache gl_state;
+  // Built lazily, variants only on first use
+  std::map<ProgramKey, ShaderProgram> programs;
+  std::string shader_sources[SHADER_TOTAL];
+  unsigned active_variant = 0;
 
-  GLuint uniform_window_size = 0;
-  GLuint uniform_center = 0;
-  GLuint uniform_scale = 0;
-  GLuint uniform_iterations = 0;
+  ProgramKey program_key(ProgramId id) const noexcept {
+    return {id, is_variant_program(id) ? active_variant : 0};
+  }
+
+  GLuint program(ProgramId id) const { return programs.at(program_key(id)); }
+
+#ifdef SHADER_HOT_RELOAD_DIR
+  std::optional<ShaderReloader> shader_reloader;
+#endif
+
+  GLuint uniform_aa_iteration_data = 0;
+  GLuint uniform_aa_samples_per_axis = 0;
+  GLuint uniform_aa_threshold = 0;
+
+  GLuint uniform_colorize_iteration_data = 0;
+  GLuint uniform_colorize_color_mode = 0;
+  GLuint uniform_colorize_palette = 0;
+  GLuint uniform_colorize_palette_period = 0;
+  GLuint uniform_colorize_palette_offset = 0;
+  GLuint uniform_colorize_palette_speed = 0;
+  GLuint uniform_colorize_time = 0;
+  GLuint uniform_colorize_cdf = 0;
+  GLuint uniform_colorize_histogram_bins = 0;
+
+  GLuint uniform_histogram_iteration_data = 0;
+  GLuint uniform_histogram_data_size = 0;
+  GLuint uniform_histogram_iterations = 0;
+  GLuint uniform_histogram_bins = 0;
+  GLuint uniform_histogram_range_pass = 0;
+
+  GLuint uniform_prefix_sum_values = 0;
+  GLuint uniform_prefix_sum_offset = 0;
+
+  GLuint uniform_iterate_first_pass = 0;
+  GLuint uniform_iterate_iteration_limit = 0;
+  GLuint uniform_iterate_input_counter = 0;
+
+  GLuint uniform_dispatch_input_counter = 0;
+  GLuint uniform_dispatch_pass = 0;
+  GLuint uniform_dispatch_max_groups_x = 0;
+
+  Uint64 startup_counter = 0;
 
   Game() : _system(SDL_INIT_VIDEO) {
+    startup_counter = SDL_GetPerformanceCounter();
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     window = PWindow(SDL_CreateWindow(
         "Hello, world!", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 800,
         600, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE));
     context = PGLContext(SDL_GL_CreateContext(window.get()));
+    int w, h;
+    SDL_GetWindowSize(window.get(), &w, &h);
+    window_width = w;
+    window_height = h;
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -39,15 +114,35 @@ struct Game {
     ImGui_ImplOpenGL3_Init();
 
     gl.emplace();
+    gl_ext.emplace();
+    program_cache.emplace(*gl_ext);
 
     // Disable V-Sync
     SDL_GL_SetSwapInterval(0);
 
     init_buffers();
+    frame_capture.emplace();
+    texture_stream.emplace(*gl_ext);
+#ifdef SHADER_HOT_RELOAD_DIR
+    shader_reloader.emplace(window.get(), context.get(), SHADER_HOT_RELOAD_DIR);
+#endif
+    Uint64 shaders_start = SDL_GetPerformanceCounter();
     init_shaders();
+    SDL_Log("Shader programs ready in %.1f ms, cache hits: %d, misses: %d",
+            elapsed_ms(shaders_start), program_cache->hits,
+            program_cache->misses);
+    upload_palette(generate_palette(256));
+    init_histogram();
+  }
+
+  static double elapsed_ms(Uint64 since) {
+    return 1000.0 * (SDL_GetPerformanceCounter() - since) /
+           SDL_GetPerformanceFrequency();
   }
 
   ~Game() {
+    stop_reference = true;
+    stop_nucleus = true;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -70,76 +165,322 @@ struct Game {
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_data), vertex_data,
                  GL_STATIC_DRAW);
 
+    // The index buffer binding is recorded in the vertex array
+    glBindVertexArray(vao);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_data), index_data,
                  GL_STATIC_DRAW);
-
-    glBindVertexArray(vao);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat[2]),
                           nullptr);
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING,
+                     gl->buf_id(BUF_ID_VIEW));
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewUniforms), nullptr,
+                 GL_DYNAMIC_DRAW);
   }
 
   void init_shaders() {
-    shader_program.emplace();
-    Shader vert_shader(GL_VERTEX_SHADER, SRC_VERT_SHADER);
-    Shader frag_shader(GL_FRAGMENT_SHADER, SRC_FRAG_SHADER);
-    glAttachShader(*shader_program, vert_shader);
-    glAttachShader(*shader_program, frag_shader);
-    glLinkProgram(*shader_program);
+    for (int id = 0; id < SHADER_TOTAL; ++id) {
+      shader_sources[id] = EMBEDDED_SHADER_SOURCES[id];
+    }
+    active_variant = desired_variant();
+    for (int id = 0; id < PROGRAM_TOTAL; ++id) {
+      if (program_wanted(ProgramId(id))) {
+        build_program(program_key(ProgramId(id)));
+      }
+    }
+    init_uniforms();
+  }
+
+  void build_program(ProgramKey key) {
+    const char *sources[SHADER_TOTAL];
+    for (int id = 0; id < SHADER_TOTAL; ++id) {
+      sources[id] = shader_sources[id].c_str();
+    }
+    programs.insert_or_assign(
+        key, program_cache->build(program_sources(key, sources)));
+#ifdef SHADER_HOT_RELOAD_DIR
+    shader_reloader->watch(key);
+#endif
+  }
+
+  int precision = PRECISION_FLOAT;
+  int formula = FORMULA_MANDELBROT;
+  bool interior_checks = true;
+
+  unsigned desired_variant() {
+    if (precision == PRECISION_DOUBLE && !gl_ext->gpu_shader_fp64) {
+      precision = PRECISION_FLOAT;
+    }
+    return shader_variant(
+        VariantPrecision(precision), VariantFormula(formula),
+        color_mode == COLOR_MODE_DISTANCE ? COLORING_DISTANCE
+                                          : COLORING_ITERATIONS,
+        interior_checks ? INTERIOR_CHECKED : INTERIOR_UNCHECKED);
+  }
+
+  // Compute programs are only built once the compute mode is enabled
+  bool program_wanted(ProgramId id) const noexcept {
+    return !is_compute_program(id) || compute_enabled();
+  }
+
+  // Switches the escape-time programs to the variant matching the settings,
+  // compiling it on first use
+  void select_variant() {
+    unsigned variant = desired_variant();
+    if (variant == active_variant && compute_enabled() == compute_built) {
+      return;
+    }
+    active_variant = variant;
+    compute_built = compute_enabled();
+    for (int id = 0; id < PROGRAM_TOTAL; ++id) {
+      ProgramKey key = program_key(ProgramId(id));
+      if (program_wanted(key.id) && !programs.count(key)) {
+        build_program(key);
+      }
+    }
+    init_uniforms();
+    iteration_data_valid = false;
+  }
 
-    GLint log_length;
-    glGetProgramiv(*shader_program, GL_INFO_LOG_LENGTH, &log_length);
+  // Powers other than 2 and Julia sets only have CPU kernels, and so do
+  // zooms past double precision
+  bool cpu_kernels = false;
+  int power = 2;
+  bool julia = false;
+  float julia_c[2] = {-0.8f, 0.156f};
+  // Null while the GPU renders the iteration data
+  CpuKernel cpu_kernel = nullptr;
+  ThreadPool thread_pool;
+  std::optional<TextureStream> texture_stream;
+  float cpu_render_ms = 0.0f;
+  static constexpr int CPU_CHUNK_ROWS = 4;
+  std::vector<CpuKernelStats> cpu_chunk_stats;
+  CpuKernelStats cpu_stats;
 
-    std::vector<GLchar> info_log(log_length);
-    glGetProgramInfoLog(*shader_program, info_log.size(), nullptr,
-                        info_log.data());
-    SDL_Log("Program linking log:\n%s", info_log.data());
+  CpuPrecision cpu_precision = CPU_PRECISION_DOUBLE;
 
-    uniform_window_size = glGetUniformLocation(*shader_program, "window_size");
-    uniform_center = glGetUniformLocation(*shader_program, "center");
-    uniform_scale = glGetUniformLocation(*shader_program, "scale");
-    uniform_iterations = glGetUniformLocation(*shader_program, "iterations");
+  // Needs the camera sampled for the frame
+  void select_cpu_kernel_for_settings(int width, int height) {
+    FloatExp pixel_size =
+        FloatExp(2.0 / std::min(width, height)) / curr_scale();
+    double x = std::abs(to_double(curr_point_x()));
+    double y = std::abs(to_double(curr_point_y()));
+    double radius = std::hypot(x + 0.5 * width * double(pixel_size),
+                               y + 0.5 * height * double(pixel_size));
+    if (julia) {
+      radius = std::max(radius, double(std::hypot(julia_c[0], julia_c[1])));
+    }
+    cpu_precision = supported_cpu_precision(
+        cpu_precision_for(pixel_size, std::max(x, y), radius),
+        VariantFormula(formula), power, julia);
+    bool deep = cpu_precision != CPU_PRECISION_DOUBLE;
+    CpuKernel kernel = nullptr;
+    if (cpu_kernels || power != 2 || julia || deep) {
+      kernel = select_cpu_kernel(VariantFormula(formula), power, julia,
+                                 color_mode == COLOR_MODE_DISTANCE,
+                                 cpu_precision);
+    }
+    if (kernel != cpu_kernel) {
+      cpu_kernel = kernel;
+      iteration_data_valid = false;
+    }
+  }
+
+  void init_uniforms() {
+    // Programs may have been replaced, cached values refer to the old ones
+    gl_state.invalidate();
+    for (auto &[key, program] : programs) {
+      GLuint block = glGetUniformBlockIndex(program, "View");
+      if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, VIEW_BLOCK_BINDING);
+      }
+    }
+
+    GLuint colorize = program(PROGRAM_ID_COLORIZE);
+    uniform_colorize_iteration_data =
+        glGetUniformLocation(colorize, "iteration_data");
+    uniform_colorize_color_mode = glGetUniformLocation(colorize, "color_mode");
+    uniform_colorize_palette = glGetUniformLocation(colorize, "palette");
+    uniform_colorize_palette_period =
+        glGetUniformLocation(colorize, "palette_period");
+    uniform_colorize_palette_offset =
+        glGetUniformLocation(colorize, "palette_offset");
+    uniform_colorize_palette_speed =
+        glGetUniformLocation(colorize, "palette_speed");
+    uniform_colorize_time = glGetUniformLocation(colorize, "time");
+    uniform_colorize_cdf = glGetUniformLocation(colorize, "cdf");
+    uniform_colorize_histogram_bins =
+        glGetUniformLocation(colorize, "histogram_bins");
+
+    GLuint aa = program(PROGRAM_ID_AA);
+    uniform_aa_iteration_data = glGetUniformLocation(aa, "iteration_data");
+    uniform_aa_samples_per_axis = glGetUniformLocation(aa, "samples_per_axis");
+    uniform_aa_threshold = glGetUniformLocation(aa, "threshold");
+
+    GLuint histogram = program(PROGRAM_ID_HISTOGRAM);
+    uniform_histogram_iteration_data =
+        glGetUniformLocation(histogram, "iteration_data");
+    uniform_histogram_bins = glGetUniformLocation(histogram, "bins");
+    uniform_histogram_range_pass =
+        glGetUniformLocation(histogram, "range_pass");
+
+    GLuint prefix_sum = program(PROGRAM_ID_PREFIX_SUM);
+    uniform_prefix_sum_values = glGetUniformLocation(prefix_sum, "values");
+    uniform_prefix_sum_offset = glGetUniformLocation(prefix_sum, "offset");
+
+    if (compute_built) {
+      GLuint iterate = program(PROGRAM_ID_ITERATE);
+      uniform_iterate_first_pass = glGetUniformLocation(iterate, "first_pass");
+      uniform_iterate_iteration_limit =
+          glGetUniformLocation(iterate, "iteration_limit");
+      uniform_iterate_input_counter =
+          glGetUniformLocation(iterate, "input_counter");
+
+      GLuint dispatch = program(PROGRAM_ID_DISPATCH);
+      uniform_dispatch_input_counter =
+          glGetUniformLocation(dispatch, "input_counter");
+      uniform_dispatch_pass = glGetUniformLocation(dispatch, "pass");
+      uniform_dispatch_max_groups_x =
+          glGetUniformLocation(dispatch, "max_groups_x");
+    }
+  }
+
+  void upload_palette(const Palette &palette) {
+    GLint max_size;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    GLsizei size = palette.size() / 3;
+    if (size > max_size) {
+      throw std::runtime_error("Palette is larger than GL_MAX_TEXTURE_SIZE");
+    }
+
+    gl_state.bind_texture_for_edit(0, GL_TEXTURE_1D,
+                                   gl->tex_id(TEX_ID_PALETTE));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, size, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                 palette.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  }
+
+  char palette_path[256] = "";
+
+  void load_palette() {
+    try {
+      upload_palette(load_palette_ppm(palette_path));
+    } catch (const std::exception &e) {
+      SDL_Log("%s", e.what());
+    }
+  }
+
+  // Allocates a float texture and attaches it to the framebuffer
+  void init_render_target(TextureId tex_id, FramebufferId fbo_id,
+                          GLenum internal_format, GLenum format, int width,
+                          int height) {
+    GLuint tex = gl->tex_id(tex_id);
+    gl_state.bind_texture_for_edit(0, GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format,
+                 GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, gl->fbo_id(fbo_id));
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      throw std::runtime_error("Render target framebuffer is incomplete");
+    }
+  }
+
+  static constexpr int HISTOGRAM_BINS = 1024;
+
+  void init_histogram() {
+    init_render_target(TEX_ID_HISTOGRAM, FBO_ID_HISTOGRAM, GL_R32F, GL_RED,
+                       HISTOGRAM_BINS, 1);
+    init_render_target(TEX_ID_CDF_0, FBO_ID_CDF_0, GL_R32F, GL_RED,
+                       HISTOGRAM_BINS, 1);
+    init_render_target(TEX_ID_CDF_1, FBO_ID_CDF_1, GL_R32F, GL_RED,
+                       HISTOGRAM_BINS, 1);
+    init_render_target(TEX_ID_ITERATION_RANGE, FBO_ID_ITERATION_RANGE,
+                       GL_RGBA32F, GL_RGBA, 1, 1);
+  }
+
+  int iteration_data_width = 0;
+  int iteration_data_height = 0;
+
+  // Iteration data is kept between frames so that recoloring does not need
+  // the fractal to be recomputed. It is allocated at the window size, with
+  // dynamic resolution only its lower left corner is rendered to.
+  void resize_iteration_data(int width, int height) {
+    if (width == iteration_data_width && height == iteration_data_height) {
+      return;
+    }
+    iteration_data_width = width;
+    iteration_data_height = height;
+    init_render_target(TEX_ID_ITERATIONS, FBO_ID_ITERATIONS, GL_RGBA32F,
+                       GL_RGBA, width, height);
+    init_render_target(TEX_ID_AA_ITERATIONS, FBO_ID_AA_ITERATIONS, GL_RGBA32F,
+                       GL_RGBA, width, height);
+    iteration_data_valid = false;
   }
 
   int fps_update_interval = 1000;
   int fps_last_tick = 0;
   int last_frame_tick = 0;
   int frames_passed = 0;
+  Uint64 last_frame_counter = 0;
+  float frame_ms = 0.0f;
+  // Shown in the window title by the event thread
+  std::atomic<float> fps = 0.0f;
 
-  int last_update_tick = 0;
-  int next_update_tick = 0;
-  float last_center_x = 0.0f;
-  float last_center_y = 0.0f;
-  float next_center_x = 0.0f;
-  float next_center_y = 0.0f;
-  float last_scale = 1.0f;
-  float next_scale = 1.0f;
+  // The event thread owns camera and publishes a copy after every change,
+  // the render thread samples the newest copy once per frame
+  Camera camera;
+  TripleBuffer<Camera> camera_exchange;
 
-  double lerp_time(double last, double next) const noexcept {
-    if (last_update_tick == next_update_tick) {
-      return next;
-    }
-    double progress = double(last_frame_tick - last_update_tick) /
-                      (next_update_tick - last_update_tick);
-    progress = std::max(0.0, std::min(1.0, progress));
-    return last + (next - last) * progress;
+  // Tick at which the render thread sampled the camera for this frame
+  int camera_tick = 0;
+  Uint64 camera_sample_counter = 0;
+
+  const Camera &view_camera() const noexcept {
+    return camera_exchange.read();
+  }
+
+  // Called as late as possible, right before the view is drawn, so that
+  // input arriving during the rest of the frame setup is still shown
+  void sample_camera() {
+    camera_exchange.update();
+    camera_tick = SDL_GetTicks();
+    camera_sample_counter = SDL_GetPerformanceCounter();
+  }
+
+  // In screen units from the origin, as the shaders take it
+  DoubleDouble curr_center_x() const {
+    return view_camera().absolute_center_x(camera_tick);
   }
 
-  double curr_center_x() const noexcept {
-    return lerp_time(last_center_x, next_center_x);
+  DoubleDouble curr_center_y() const {
+    return view_camera().absolute_center_y(camera_tick);
   }
 
-  double curr_center_y() const noexcept {
-    return lerp_time(last_center_y, next_center_y);
+  DoubleDouble curr_point_x() const {
+    return view_camera().point_x(camera_tick);
   }
 
-  double curr_scale() const noexcept {
-    return lerp_time(last_scale, next_scale);
+  DoubleDouble curr_point_y() const {
+    return view_camera().point_y(camera_tick);
+  }
+
+  FloatExp curr_scale() const noexcept {
+    return view_camera().scale(camera_tick);
   }
 
   void update_time() {
@@ -147,163 +488,1377 @@ struct Game {
     int ms_passed = current_tick - fps_last_tick;
 
     if (ms_passed > fps_update_interval) {
-      float fps = 1000.0f * frames_passed / ms_passed;
-      std::ostringstream oss;
-      oss.setf(std::ios::fixed);
-      oss.precision(1);
-      oss << "FPS: " << fps;
-      SDL_SetWindowTitle(window.get(), oss.str().c_str());
+      fps = 1000.0f * frames_passed / ms_passed;
       fps_last_tick = current_tick;
       frames_passed = 0;
     }
 
     ++frames_passed;
 
-    int dt = current_tick - last_frame_tick;
     last_frame_tick = current_tick;
+
+    Uint64 current_counter = SDL_GetPerformanceCounter();
+    frame_ms = 1000.0 * (current_counter - last_frame_counter) /
+               SDL_GetPerformanceFrequency();
+    last_frame_counter = current_counter;
   }
 
   int transition_ticks = 125;
   // Single precision because of ImGui
   float scroll_coef = 0.25f;
+  // Copies of the two settings above for the event thread
+  std::atomic<int> input_transition_ticks = 125;
+  std::atomic<float> input_scroll_coef = 0.25f;
 
-  void scroll(double x, double y, double delta) {
-    int w, h;
-    SDL_GetWindowSize(window.get(), &w, &h);
-    int min_dim = std::min(w, h);
-
-    double cx = curr_center_x();
-    double cy = curr_center_y();
-    double s = curr_scale();
-
-    last_center_x = cx;
-    last_center_y = cy;
-    last_scale = s;
-    next_scale *= 1.0 + scroll_coef * delta;
-    last_update_tick = last_frame_tick;
-    next_update_tick = last_update_tick + transition_ticks;
-
-    // ssx (screen space x) = (2x - w) / min_dim
-    // preserve_x = (ssx + cx) / s;
-    // (ssx + cx') / s' = (ssx + cx) / s
-    // cx' / s' = ssx * (1/s - 1/s') + cx / s
-    // cx' = (s' / s - 1) * ssx + s' / s * cx
-    double ratio = next_scale / s;
-    next_center_x = (ratio - 1.0) * (2 * x - w) / min_dim + ratio * cx;
-    next_center_y = (ratio - 1.0) * (h - 2 * y) / min_dim + ratio * cy;
-  }
-
-  void drag(double xrel, double yrel) {
-    int w, h;
-    SDL_GetWindowSize(window.get(), &w, &h);
-    int min_dim = std::min(w, h);
+  std::atomic<bool> is_running = true;
 
-    double cx = curr_center_x();
-    double cy = curr_center_y();
-    double s = curr_scale();
+  // Set by the event thread on SDL_WINDOWEVENT_SIZE_CHANGED
+  std::atomic<int> window_width = 0;
+  std::atomic<int> window_height = 0;
 
-    // ((2x - w) / min_dim + cx) / s = ((2x' - w) / min_dim + cx') / s
-    // (2x - w) / min_dim + cx = (2x' - w) / min_dim + cx'
-    // dcx = -2dx / min_dim
-    cx -= 2.0 * xrel / min_dim;
-    cy += 2.0 * yrel / min_dim;
+  // Motion and wheel input of one batch of events, applied to the camera
+  // at once. Consecutive drags add up and consecutive zooms at the same
+  // point multiply, so the result matches applying them one by one.
+  double pending_drag_x = 0.0;
+  double pending_drag_y = 0.0;
+  bool pending_drag = false;
+  double pending_zoom = 1.0;
+  int pending_zoom_x = 0;
+  int pending_zoom_y = 0;
+  bool pending_wheel = false;
+  Uint32 pending_timestamp = 0;
+  bool camera_moved = false;
 
-    last_center_x = next_center_x = cx;
-    last_center_y = next_center_y = cy;
-    last_scale = next_scale = s;
-    last_update_tick = next_update_tick = last_frame_tick;
+  void queue_input(Uint32 timestamp) {
+    if (!pending_drag && !pending_wheel) {
+      pending_timestamp = timestamp;
+    }
   }
 
-  bool is_running = true;
+  void flush_input() {
+    if (!pending_drag && !pending_wheel) {
+      return;
+    }
+    int tick = SDL_GetTicks();
+    if (pending_drag) {
+      camera.drag(tick, window_width, window_height, pending_drag_x,
+                  pending_drag_y);
+    } else {
+      camera.scroll(tick, input_transition_ticks, window_width,
+                    window_height, pending_zoom_x, pending_zoom_y,
+                    pending_zoom);
+    }
+    camera.input_queued_ms = tick - std::min<Uint32>(tick, pending_timestamp);
+    pending_drag_x = pending_drag_y = 0.0;
+    pending_zoom = 1.0;
+    pending_drag = pending_wheel = false;
+    camera_moved = true;
+  }
 
-  void poll_events() {
-    SDL_Event evt;
-    while (SDL_PollEvent(&evt)) {
+  // Runs on the event thread
+  void handle_event(const SDL_Event &evt) {
+    if (evt.type == SDL_WINDOWEVENT) {
+      if (evt.window.event == SDL_WINDOWEVENT_CLOSE) {
+        is_running = false;
+      } else if (evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+        flush_input();
+        window_width = evt.window.data1;
+        window_height = evt.window.data2;
+      }
+    } else if (evt.type == SDL_KEYDOWN) {
+      if (evt.key.keysym.scancode == SDL_SCANCODE_ESCAPE) {
+        is_running = false;
+      } else if (evt.key.keysym.scancode == SDL_SCANCODE_F12) {
+        screenshot_requested = true;
+      } else if (evt.key.keysym.scancode == SDL_SCANCODE_N) {
+        nucleus_requested = true;
+      } else if (evt.key.keysym.scancode == SDL_SCANCODE_EQUALS) {
+        flush_input();
+        camera.reset(SDL_GetTicks(), input_transition_ticks);
+        camera.input_queued_ms = 0;
+        camera_moved = true;
+      }
+    } else if (evt.type == SDL_MOUSEWHEEL) {
+      bool moved_pointer = pending_zoom_x != evt.wheel.mouseX ||
+                           pending_zoom_y != evt.wheel.mouseY;
+      if (pending_drag || (pending_wheel && moved_pointer)) {
+        flush_input();
+      }
+      queue_input(evt.wheel.timestamp);
+      pending_zoom *= 1.0 + input_scroll_coef * evt.wheel.y;
+      pending_zoom_x = evt.wheel.mouseX;
+      pending_zoom_y = evt.wheel.mouseY;
+      pending_wheel = true;
+    } else if (evt.type == SDL_MOUSEMOTION) {
+      if (evt.motion.state & SDL_BUTTON_LMASK) {
+        if (pending_wheel) {
+          flush_input();
+        }
+        queue_input(evt.motion.timestamp);
+        pending_drag_x += evt.motion.xrel;
+        pending_drag_y += evt.motion.yrel;
+        pending_drag = true;
+      }
+    }
+  }
+
+  // The minibrot of the lowest period in the view, located in the background
+  // on request and then zoomed into, so that it fills the view. The view
+  // then looks at the nucleus itself, and the render thread makes its
+  // periodic orbit the reference of the perturbed pixels.
+  static constexpr double NUCLEUS_VIEW_SIZES = 2.0;
+  std::atomic<bool> nucleus_requested = false;
+  std::atomic<bool> nucleus_locating = false;
+  // Of the last one located, 0 where there was none and -1 before the first
+  std::atomic<int> nucleus_period = -1;
+  std::atomic<float> nucleus_zoom = 0.0f;
+  std::atomic<bool> stop_nucleus{false};
+  std::future<Nucleus> next_nucleus;
+  // Copy of mandelbrot_iters for the event thread
+  std::atomic<int> input_iters = 256;
+
+  // Nucleus zoomed into, with the anchor version the zoom gave the camera,
+  // handed over to the render thread
+  struct NucleusTarget {
+    Nucleus nucleus;
+    unsigned anchor_version = 0;
+  };
+  std::mutex nucleus_target_mutex;
+  std::optional<NucleusTarget> zoomed_nucleus;
+
+  // Runs on the event thread, which owns the camera
+  void update_nucleus() {
+    if (nucleus_requested.exchange(false) && !next_nucleus.valid()) {
+      flush_input();
+      int tick = SDL_GetTicks();
+      FloatExp scale = camera.scale(tick);
+      int limbs = Camera::fraction_limbs_for(scale);
+      int min_dim = std::max(1, std::min<int>(window_width, window_height));
+      nucleus_locating = true;
+      next_nucleus = std::async(
+          std::launch::async,
+          [this, x = camera.exact_point_x(tick, limbs),
+           y = camera.exact_point_y(tick, limbs),
+           rx = FloatExp(double(window_width) / min_dim) / scale,
+           ry = FloatExp(double(window_height) / min_dim) / scale,
+           iterations = int(input_iters)] {
+            return locate_nucleus(x, y, rx, ry, iterations, &stop_nucleus);
+          });
+    }
+    if (!next_nucleus.valid() ||
+        next_nucleus.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      return;
+    }
+    Nucleus nucleus = next_nucleus.get();
+    nucleus_locating = false;
+    nucleus_period = nucleus.period;
+    if (!nucleus.period) {
+      SDL_Log("No minibrot found in the view");
+      return;
+    }
+    FloatExp scale = FloatExp(1.0 / NUCLEUS_VIEW_SIZES) / nucleus.size;
+    nucleus_zoom = log2(scale) * std::log10(2.0);
+    SDL_Log("Minibrot of period %d, zooming to 10^%.1f", nucleus.period,
+            double(nucleus_zoom));
+    flush_input();
+    camera.zoom_to(SDL_GetTicks(), input_transition_ticks, nucleus.x,
+                   nucleus.y, scale);
+    camera.input_queued_ms = 0;
+    camera_moved = true;
+    std::lock_guard<std::mutex> lock(nucleus_target_mutex);
+    zoomed_nucleus = NucleusTarget{std::move(nucleus), camera.anchor_version};
+  }
+
+  // Applies the coalesced input of a batch and hands the camera over
+  void publish_camera() {
+    flush_input();
+    if (!camera_moved) {
+      return;
+    }
+    camera.input_counter = SDL_GetPerformanceCounter();
+    camera_exchange.write_slot() = camera;
+    camera_exchange.publish();
+    camera_moved = false;
+  }
+
+  // Events are forwarded to ImGui on the render thread, which owns the UI,
+  // see THREADED_RENDERING
+  std::mutex ui_events_mutex;
+  std::vector<SDL_Event> ui_events;
+  std::vector<SDL_Event> ui_events_back;
+
+  void process_ui_events() {
+    {
+      std::lock_guard<std::mutex> lock(ui_events_mutex);
+      ui_events.swap(ui_events_back);
+    }
+    for (SDL_Event &evt : ui_events_back) {
       ImGui_ImplSDL2_ProcessEvent(&evt);
+    }
+    ui_events_back.clear();
+  }
 
-      if (evt.type == SDL_WINDOWEVENT &&
-          evt.window.event == SDL_WINDOWEVENT_CLOSE) {
-        is_running = false;
-      } else if (evt.type == SDL_KEYDOWN) {
-        if (evt.key.keysym.scancode == SDL_SCANCODE_ESCAPE) {
-          is_running = false;
-        } else if (evt.key.keysym.scancode == SDL_SCANCODE_EQUALS) {
-          double cx = curr_center_x();
-          double cy = curr_center_y();
-          double s = curr_scale();
-
-          last_center_x = cx;
-          last_center_y = cy;
-          last_scale = s;
-          next_scale = 1.0;
-          next_center_x = 0.0;
-          next_center_y = 0.0;
-          last_update_tick = last_frame_tick;
-          next_update_tick = last_update_tick + transition_ticks;
+  // Latency of the input that moved the camera, split into the time spent
+  // in SDL's event queue, until a frame sampled the camera, and from there
+  // until the swap. The measurement mode waits for the GPU after the swap,
+  // so the last stage includes the rendering itself.
+  bool measure_latency = false;
+  Uint64 presented_input_counter = 0;
+  float latency_queued_ms = 0.0f;
+  float latency_sampled_ms = 0.0f;
+  float latency_swapped_ms = 0.0f;
+  float latency_max_ms = 0.0f;
+
+  static void smooth(float &average, float sample) {
+    average = average > 0.0f ? 0.875f * average + 0.125f * sample : sample;
+  }
+
+  void measure_input_latency() {
+    const Camera &camera = view_camera();
+    if (camera.input_counter == presented_input_counter) {
+      return;
+    }
+    presented_input_counter = camera.input_counter;
+    float freq = SDL_GetPerformanceFrequency();
+    float sampled = 1000.0f * (camera_sample_counter - camera.input_counter) /
+                    freq;
+    float swapped = elapsed_ms(camera_sample_counter);
+    smooth(latency_queued_ms, camera.input_queued_ms);
+    smooth(latency_sampled_ms, sampled);
+    smooth(latency_swapped_ms, swapped);
+    latency_max_ms = std::max(latency_max_ms,
+                              camera.input_queued_ms + sampled + swapped);
+  }
+
+  int mandelbrot_iters = 256;
+
+  enum ColorMode {
+    COLOR_MODE_ITERATIONS = 0,
+    COLOR_MODE_DISTANCE,
+    COLOR_MODE_PALETTE,
+    COLOR_MODE_HISTOGRAM,
+  };
+  int color_mode = COLOR_MODE_PALETTE;
+  float palette_period = 64.0f;
+  float palette_offset = 0.0f;
+  float palette_speed = 0.0f;
+
+  bool iteration_data_valid = false;
+  // Incremented each time the iteration data is recomputed
+  unsigned iteration_data_version = 0;
+  // Camera state, the center is relative to the anchor
+  unsigned rendered_anchor_version = 0;
+  DoubleDouble rendered_center_x;
+  DoubleDouble rendered_center_y;
+  FloatExp rendered_scale;
+  int rendered_iters = 0;
+  int rendered_width = 0;
+  int rendered_height = 0;
+
+  bool view_changed() const noexcept {
+    const Camera &camera = view_camera();
+    return !iteration_data_valid ||
+           rendered_anchor_version != camera.anchor_version ||
+           rendered_center_x != camera.center_x(camera_tick) ||
+           rendered_center_y != camera.center_y(camera_tick) ||
+           rendered_scale != curr_scale() ||
+           rendered_iters != mandelbrot_iters;
+  }
+
+  bool dynamic_resolution = true;
+  float target_frame_ms = 1000.0f / 60.0f;
+  float min_render_scale = 0.25f;
+  float render_scale = 1.0f;
+  bool last_frame_moving = false;
+
+  // While the view changes, the fraction of the window that is rendered
+  // follows the measured frame time. Cost is proportional to the pixel
+  // count, hence the square root. Once the view settles it is rendered at
+  // the native resolution.
+  float update_render_scale() {
+    bool moving = iteration_data_valid && view_changed();
+    if (!dynamic_resolution || !moving) {
+      last_frame_moving = false;
+      return 1.0f;
+    }
+    if (last_frame_moving && frame_ms > 0.0f) {
+      float factor = std::sqrt(target_frame_ms / frame_ms);
+      factor = std::max(0.75f, std::min(1.125f, factor));
+      render_scale *= factor;
+      render_scale = std::max(min_render_scale, std::min(1.0f, render_scale));
+    }
+    last_frame_moving = true;
+    return render_scale;
+  }
+
+  // Doubles reach the shaders as the sum of a float and its rounding error
+  static void split(double value, GLfloat &hi, GLfloat &lo) {
+    hi = value;
+    lo = value - hi;
+  }
+
+  static void split(DoubleDouble value, GLfloat &hi, GLfloat &lo) {
+    hi = value.hi;
+    lo = (value.hi - hi) + value.lo;
+  }
+
+  ViewUniforms view_uniforms = {};
+
+  // Uploads the parameters every pass reads once per frame, only when they
+  // differ from the previous upload. They describe the data being rendered
+  // this frame, which is what the later passes use too.
+  void update_view_uniforms(int window_width, int window_height,
+                            int data_width, int data_height) {
+    ViewUniforms view = {};
+    view.window_size[0] = window_width;
+    view.window_size[1] = window_height;
+    view.data_size[0] = data_width;
+    view.data_size[1] = data_height;
+    split(curr_center_x(), view.center[0], view.center_lo[0]);
+    split(curr_center_y(), view.center[1], view.center_lo[1]);
+    split(double(curr_scale()), view.scale, view.scale_lo);
+    view.iterations = mandelbrot_iters;
+    if (std::memcmp(&view, &view_uniforms, sizeof(view)) == 0) {
+      return;
+    }
+    view_uniforms = view;
+    glBindBuffer(GL_UNIFORM_BUFFER, gl->buf_id(BUF_ID_VIEW));
+    glBufferSubData(GL_UNIFORM_BUFFER, 0,
+                    offsetof(ViewUniforms, iteration_range), &view);
+  }
+
+  void draw_fullscreen() {
+    gl_state.bind_vertex_array(gl->vao_id(VAO_ID_FULLSCREEN));
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+  }
+
+  void draw_fractal(int width, int height) {
+    poll_reference_orbit();
+    if (!view_changed() && rendered_width == width &&
+        rendered_height == height) {
+      return;
+    }
+
+    if (cpu_kernel) {
+      draw_fractal_cpu(width, height);
+    } else if (compute_enabled()) {
+      draw_fractal_compute(width, height);
+    } else {
+      gl_state.bind_framebuffer(GL_FRAMEBUFFER,
+                                gl->fbo_id(FBO_ID_ITERATIONS));
+      gl_state.use_program(program(PROGRAM_ID_FRACTAL));
+      draw_fullscreen();
+    }
+
+    iteration_data_valid = true;
+    ++iteration_data_version;
+    const Camera &camera = view_camera();
+    rendered_anchor_version = camera.anchor_version;
+    rendered_center_x = camera.center_x(camera_tick);
+    rendered_center_y = camera.center_y(camera_tick);
+    rendered_scale = curr_scale();
+    rendered_iters = mandelbrot_iters;
+    rendered_width = width;
+    rendered_height = height;
+  }
+
+  // Reference orbits serve views whose middle is within this many view
+  // radii of their point
+  static constexpr double REFERENCE_REACH = 2.0;
+
+  ReferenceOrbit reference_orbit;
+  float reference_ms = 0.0f;
+  // Incremented with each new orbit
+  unsigned reference_version = 0;
+  int reference_frames = 0;
+  // Middle of the view relative to the reference point
+  FloatExp reference_dx;
+  FloatExp reference_dy;
+  // Whether the orbit had the bits the last frame needed
+  bool reference_exact = true;
+
+  struct ComputedReference {
+    ReferenceOrbit orbit;
+    float ms = 0.0f;
+  };
+  // Set to stop the job in flight, reset for each one
+  std::atomic<bool> stop_reference{false};
+  std::future<ComputedReference> next_reference;
+  // Point and iterations of the job in flight
+  BigFixed next_reference_x;
+  BigFixed next_reference_y;
+  int next_reference_iterations = 0;
+
+  // With a period, (cx, cy) is a nucleus of it and the job computes its
+  // periodic orbit instead
+  void start_reference_orbit(BigFixed cx, BigFixed cy, int period = 0) {
+    stop_reference = false;
+    next_reference_x = cx;
+    next_reference_y = cy;
+    next_reference_iterations = mandelbrot_iters;
+    next_reference = std::async(
+        std::launch::async,
+        [this, cx = std::move(cx), cy = std::move(cy), period,
+         iterations = mandelbrot_iters] {
+          Uint64 start = SDL_GetPerformanceCounter();
+          ComputedReference result;
+          if (period > 0) {
+            result.orbit.compute_periodic(cx, cy, period,
+                                          cpu_kernels::BAILOUT<double>,
+                                          &stop_reference);
+          } else {
+            result.orbit.compute(cx, cy, iterations,
+                                 cpu_kernels::BAILOUT<double>,
+                                 &stop_reference);
+          }
+          result.ms = elapsed_ms(start);
+          return result;
+        });
+  }
+
+  // Stops the job in flight and drops its orbit, which it leaves short
+  void cancel_reference_orbit() {
+    stop_reference = true;
+    next_reference.wait();
+    next_reference = {};
+  }
+
+  // Waits for the orbit computed in the background
+  void take_reference_orbit() {
+    ComputedReference result = next_reference.get();
+    reference_orbit = std::move(result.orbit);
+    reference_ms = result.ms;
+    ++reference_version;
+    reference_frames = 0;
+  }
+
+  // Called every frame. A frame rendered with an orbit short of bits is
+  // redone once the next one is ready, and so is one rendered before the
+  // orbit of the nucleus it looks at.
+  void poll_reference_orbit() {
+    if (next_reference.valid() &&
+        next_reference.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready) {
+      take_reference_orbit();
+      if (!reference_exact || reference_orbit.periodic) {
+        iteration_data_valid = false;
+      }
+    }
+  }
+
+  std::optional<NucleusTarget> nucleus_target;
+
+  // Once the zoom into a nucleus ends with the nucleus in the middle of the
+  // view, its periodic orbit is computed in the background to replace
+  // whichever orbit the transition left, which is kept while close enough
+  // but may escape and leave glitches where the nucleus never does. Dropped
+  // once the camera moves the anchor away from it.
+  void update_nucleus_reference(int limbs) {
+    {
+      std::lock_guard<std::mutex> lock(nucleus_target_mutex);
+      if (zoomed_nucleus) {
+        nucleus_target = std::move(zoomed_nucleus);
+        zoomed_nucleus.reset();
+      }
+    }
+    if (!nucleus_target) {
+      return;
+    }
+    const Camera &camera = view_camera();
+    if (camera.anchor_version != nucleus_target->anchor_version) {
+      nucleus_target.reset();
+      return;
+    }
+    if (camera.center_x(camera_tick).hi != 0.0 ||
+        camera.center_y(camera_tick).hi != 0.0) {
+      return;
+    }
+    Nucleus &nucleus = nucleus_target->nucleus;
+    limbs = std::max(limbs, nucleus.x.fraction_limbs());
+    nucleus.x.set_fraction_limbs(limbs);
+    nucleus.y.set_fraction_limbs(limbs);
+    if (next_reference.valid()) {
+      cancel_reference_orbit();
+    }
+    start_reference_orbit(std::move(nucleus.x), std::move(nucleus.y),
+                          nucleus.period);
+    nucleus_target.reset();
+  }
+
+  // Keeps the orbit while its point stays within REFERENCE_REACH view radii
+  // of the middle of the view and it has the bits and iterations the view
+  // needs, so pans and zooms only move the pixels relative to it. Otherwise
+  // the orbit of the middle is computed in the background, and the current
+  // one renders meanwhile unless it is too short, or too far for the pixel
+  // offsets to be told apart in double. A job in flight for a point that
+  // the view has since left, or with too few bits or iterations, is
+  // cancelled for the new one.
+  void update_reference_orbit(int width, int height) {
+    int limbs = Camera::fraction_limbs_for(curr_scale());
+    const Camera &camera = view_camera();
+    BigFixed x = camera.exact_point_x(camera_tick, limbs);
+    BigFixed y = camera.exact_point_y(camera_tick, limbs);
+    FloatExp radius =
+        FloatExp(std::hypot(width, height) / std::min(width, height)) /
+        curr_scale();
+    update_nucleus_reference(limbs);
+    for (;;) {
+      reference_dx = (x - reference_orbit.cx).to_float_exp();
+      reference_dy = (y - reference_orbit.cy).to_float_exp();
+      FloatExp distance = std::max(abs(reference_dx), abs(reference_dy));
+      bool usable = reference_orbit.size() > 0 &&
+                    reference_orbit.reaches(mandelbrot_iters) &&
+                    log2(distance) - log2(radius) < 32.0;
+      reference_exact = reference_orbit.cx.fraction_limbs() >= limbs;
+      if (usable && reference_exact &&
+          distance < radius * REFERENCE_REACH) {
+        break;
+      }
+      if (next_reference.valid()) {
+        FloatExp next_distance =
+            std::max(abs((x - next_reference_x).to_float_exp()),
+                     abs((y - next_reference_y).to_float_exp()));
+        if (next_reference_x.fraction_limbs() < limbs ||
+            next_reference_iterations < mandelbrot_iters ||
+            !(next_distance < radius * REFERENCE_REACH)) {
+          cancel_reference_orbit();
         }
-      } else if (evt.type == SDL_MOUSEWHEEL) {
-        scroll(evt.wheel.mouseX, evt.wheel.mouseY, evt.wheel.y);
-      } else if (evt.type == SDL_MOUSEMOTION) {
-        if (evt.motion.state & SDL_BUTTON_LMASK) {
-          drag(evt.motion.xrel, evt.motion.yrel);
+      }
+      if (!next_reference.valid()) {
+        start_reference_orbit(x, y);
+      }
+      if (usable) {
+        break;
+      }
+      take_reference_orbit();
+    }
+    ++reference_frames;
+  }
+
+  OrbitWindows reference_windows;
+  unsigned windows_reference_version = 0;
+
+  // Regenerates the start of a compressed orbit once for every frame that
+  // uses it, instead of in every chunk of every frame
+  void update_reference_windows() {
+    if (windows_reference_version == reference_version) {
+      return;
+    }
+    int windows = reference_windows.assign(reference_orbit);
+    thread_pool.parallel_for(
+        windows, [&](int window) { reference_windows.regenerate(window); });
+    windows_reference_version = reference_version;
+  }
+
+  bool bilinear_approximation = true;
+  BlaTable bla_table;
+  float bla_ms = 0.0f;
+  unsigned bla_reference_version = 0;
+  FloatExp bla_max_dc;
+
+  // Approximations over the reference orbit that hold for every pixel of
+  // the view, out to its corners. Radii for a larger |dc| still hold, so
+  // the table has some room and is only rebuilt for a new orbit, a view
+  // that outgrows it or one far smaller.
+  void update_bla_table(int width, int height) {
+    FloatExp max_dc =
+        FloatExp(std::hypot(width, height) / std::min(width, height)) /
+            curr_scale() +
+        abs(reference_dx) + abs(reference_dy);
+    if (bla_reference_version == reference_version &&
+        !(bla_max_dc < max_dc) && !(ldexp(max_dc, 6) < bla_max_dc)) {
+      return;
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    bla_max_dc = ldexp(max_dc, 2);
+    bla_table.build(reference_orbit, bla_max_dc, &reference_windows);
+    bla_reference_version = reference_version;
+    bla_ms = elapsed_ms(start);
+  }
+
+  // Rows are spread over the thread pool and written straight into mapped
+  // upload memory, then copied by the GPU into the same texture the fractal
+  // pass renders to
+  void draw_fractal_cpu(int width, int height) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    bool bla = cpu_precision == CPU_PRECISION_PERTURBATION &&
+               bilinear_approximation;
+    if (cpu_precision == CPU_PRECISION_PERTURBATION) {
+      update_reference_orbit(width, height);
+      update_reference_windows();
+    }
+    if (bla) {
+      update_bla_table(width, height);
+    }
+    CpuView view = {width,           height,        curr_point_x(),
+                    curr_point_y(),  curr_scale(),  mandelbrot_iters,
+                    interior_checks, julia_c[0],    julia_c[1],
+                    &reference_orbit, reference_dx, reference_dy,
+                    bla ? &bla_table : nullptr,
+                    &reference_windows};
+    if (cpu_precision == CPU_PRECISION_PERTURBATION) {
+      glitch_mask.resize(std::size_t(width) * height);
+      view.glitches = glitch_mask.data();
+    }
+    auto *data = static_cast<float *>(
+        texture_stream->map(sizeof(float[4]) * width * height));
+    if (!data) {
+      SDL_Log("Could not map the texture upload buffer");
+      return;
+    }
+    // Lanes are refilled within a chunk, so only its last few pixels leave
+    // lanes idle
+    int chunk = CPU_CHUNK_ROWS * width;
+    int chunks = (width * height + chunk - 1) / chunk;
+    cpu_chunk_stats.assign(chunks, {});
+    CpuKernel kernel = cpu_kernel;
+    thread_pool.parallel_for(chunks, [&](int i) {
+      cpu_chunk_stats[i] = kernel(view, i * chunk,
+                                  std::min((i + 1) * chunk, width * height),
+                                  data);
+    });
+    cpu_stats = {};
+    for (const CpuKernelStats &stats : cpu_chunk_stats) {
+      cpu_stats += stats;
+    }
+    if (view.glitches) {
+      correct_glitches(view, data);
+    }
+    gl_state.bind_texture_for_edit(0, GL_TEXTURE_2D,
+                                   gl->tex_id(TEX_ID_ITERATIONS));
+    texture_stream->upload(width, height, GL_RGBA, GL_FLOAT);
+    cpu_render_ms = elapsed_ms(start);
+  }
+
+  static constexpr int MAX_GLITCH_ROUNDS = 4;
+  static constexpr int MAX_GLITCH_REFERENCES = 64;
+  std::vector<std::uint8_t> glitch_mask;
+  int glitch_pixels = 0;
+  int glitch_references = 0;
+  int glitches_left = 0;
+  float glitch_ms = 0.0f;
+
+  // 4-connected groups of the pixels flagged in glitch_mask, largest first
+  std::vector<std::vector<int>> glitch_clusters(int width, int height) {
+    std::vector<std::vector<int>> clusters;
+    std::vector<std::uint8_t> seen(glitch_mask.size(), 0);
+    for (int p = 0; p < width * height; ++p) {
+      if (!glitch_mask[p] || seen[p]) {
+        continue;
+      }
+      std::vector<int> cluster = {p};
+      seen[p] = 1;
+      for (std::size_t i = 0; i < cluster.size(); ++i) {
+        int x = cluster[i] % width, y = cluster[i] / width;
+        for (auto [nx, ny] : {std::pair{x - 1, y}, std::pair{x + 1, y},
+                              std::pair{x, y - 1}, std::pair{x, y + 1}}) {
+          int q = ny * width + nx;
+          if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
+              glitch_mask[q] && !seen[q]) {
+            seen[q] = 1;
+            cluster.push_back(q);
+          }
         }
       }
+      clusters.push_back(std::move(cluster));
     }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.size() > b.size();
+                     });
+    return clusters;
   }
 
-  int mandelbrot_iters = 256;
+  // Each cluster of glitched pixels gets the orbit of its pixel nearest to
+  // its middle, computed in parallel with the others, and only its pixels
+  // are rendered again. Rounds repeat for pixels that outlast their new
+  // reference too.
+  void correct_glitches(const CpuView &view, float *data) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    glitch_pixels = int(std::count(glitch_mask.begin(), glitch_mask.end(), 1));
+    glitch_references = 0;
+    int limbs = Camera::fraction_limbs_for(view.scale);
+    const Camera &camera = view_camera();
+    BigFixed x = camera.exact_point_x(camera_tick, limbs);
+    BigFixed y = camera.exact_point_y(camera_tick, limbs);
+    FloatExp pixel_size =
+        FloatExp(2.0 / std::min(view.width, view.height)) / view.scale;
+    std::vector<std::vector<int>> clusters;
+    for (int round = 0; round < MAX_GLITCH_ROUNDS; ++round) {
+      clusters = glitch_clusters(view.width, view.height);
+      if (clusters.empty()) {
+        break;
+      }
+      if (int(clusters.size()) > MAX_GLITCH_REFERENCES) {
+        clusters.resize(MAX_GLITCH_REFERENCES);
+      }
+      glitch_references += int(clusters.size());
+      thread_pool.parallel_for(int(clusters.size()), [&](int i) {
+        const std::vector<int> &cluster = clusters[i];
+        double mx = 0.0, my = 0.0;
+        for (int p : cluster) {
+          mx += p % view.width;
+          my += p / view.width;
+        }
+        mx /= cluster.size();
+        my /= cluster.size();
+        auto distance = [&](int p, double cx, double cy) {
+          return std::hypot(p % view.width - cx, p / view.width - cy);
+        };
+        int middle = *std::min_element(
+            cluster.begin(), cluster.end(), [&](int a, int b) {
+              return distance(a, mx, my) < distance(b, mx, my);
+            });
+        int px = middle % view.width, py = middle / view.width;
+        FloatExp dx = pixel_size * (px + 0.5 - 0.5 * view.width);
+        FloatExp dy = pixel_size * (py + 0.5 - 0.5 * view.height);
+        ReferenceOrbit orbit;
+        orbit.compute(x + BigFixed::from_double(dx.mantissa, dx.exponent,
+                                                limbs),
+                      y + BigFixed::from_double(dy.mantissa, dy.exponent,
+                                                limbs),
+                      view.iterations, cpu_kernels::BAILOUT<double>);
+        CpuView corrected = view;
+        corrected.reference = &orbit;
+        corrected.reference_windows = nullptr;
+        corrected.reference_dx = -dx;
+        corrected.reference_dy = -dy;
+        corrected.pixels = cluster.data();
+        BlaTable bla;
+        if (view.bla) {
+          double reach = 0.0;
+          for (int p : cluster) {
+            reach = std::max(reach, distance(p, px, py));
+          }
+          bla.build(orbit, pixel_size * (reach + 1.0));
+          corrected.bla = &bla;
+        }
+        cpu_kernel(corrected, 0, int(cluster.size()), data);
+      });
+    }
+    glitches_left =
+        int(std::count(glitch_mask.begin(), glitch_mask.end(), 1));
+    glitch_ms = elapsed_ms(start);
+  }
 
-  void redraw() {
-    int window_width, window_height;
-    SDL_GetWindowSize(window.get(), &window_width, &window_height);
-    glViewport(0, 0, window_width, window_height);
+  static constexpr int MAX_COMPUTE_PASSES = 64;
+  bool compute_passes = false;
+  int compute_pass_iterations = 32;
+  // Whether the compute programs of the active variant are built
+  bool compute_built = false;
+  GLsizeiptr compute_capacity = 0;
+  // Pixels each pass ran on, read back once the passes have finished
+  GLsync compute_stats_fence = nullptr;
+  int compute_stats_passes = 0;
+  std::vector<GLuint> compute_active;
+
+  bool compute_enabled() const noexcept {
+    return compute_passes && gl_ext->compute_shader;
+  }
+
+  // Iterates in passes of a few iterations each. Most pixels escape during
+  // the first pass, so every pass appends the pixels still running to a
+  // list, and the next one is dispatched indirectly over that list only.
+  // Two lists and two counters alternate between the passes.
+  void draw_fractal_compute(int width, int height) {
+    GLsizeiptr pixels = GLsizeiptr(width) * height;
+    if (pixels > compute_capacity) {
+      compute_capacity = pixels;
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER,
+                   gl->buf_id(BUF_ID_PIXEL_STATES));
+      glBufferData(GL_SHADER_STORAGE_BUFFER,
+                   COMPUTE_PIXEL_STATE_SIZE * pixels, nullptr,
+                   GL_DYNAMIC_COPY);
+      for (BufferId id : {BUF_ID_PIXEL_LIST_0, BUF_ID_PIXEL_LIST_1}) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl->buf_id(id));
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * pixels,
+                     nullptr, GL_DYNAMIC_COPY);
+      }
+    }
+
+    int iterations = std::max(1, mandelbrot_iters);
+    int per_pass = std::max(compute_pass_iterations,
+                            (iterations + MAX_COMPUTE_PASSES - 1) /
+                                MAX_COMPUTE_PASSES);
+    int passes = (iterations + per_pass - 1) / per_pass;
+
+    // Two counters of {groups_x, groups_y, groups_z, count}, then the
+    // number of pixels of every pass
+    GLuint counters[8 + MAX_COMPUTE_PASSES] = {0, 1, 1, 0, 0, 1, 1, 0};
+    counters[8] = pixels;
+    GLuint counter_buffer = gl->buf_id(BUF_ID_PASS_COUNTERS);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counters), counters,
+                 GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+                     gl->buf_id(BUF_ID_PIXEL_STATES));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counter_buffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counter_buffer);
+    gl_ext->BindImageTexture(0, gl->tex_id(TEX_ID_ITERATIONS), 0, GL_FALSE,
+                             0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    GLuint lists[] = {gl->buf_id(BUF_ID_PIXEL_LIST_0),
+                      gl->buf_id(BUF_ID_PIXEL_LIST_1)};
+    for (int pass = 0; pass < passes; ++pass) {
+      int input = pass % 2;
+      if (pass > 0) {
+        gl_state.use_program(program(PROGRAM_ID_DISPATCH));
+        gl_state.uniform(uniform_dispatch_input_counter, input);
+        gl_state.uniform(uniform_dispatch_pass, pass);
+        gl_state.uniform(uniform_dispatch_max_groups_x,
+                         GLint(gl_ext->max_compute_groups_x));
+        gl_ext->DispatchCompute(1, 1, 1);
+        gl_ext->MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT |
+                              GL_COMMAND_BARRIER_BIT);
+      }
+      gl_state.use_program(program(PROGRAM_ID_ITERATE));
+      gl_state.uniform(uniform_iterate_first_pass, GLint(pass == 0));
+      gl_state.uniform(uniform_iterate_iteration_limit,
+                       std::min(iterations, (pass + 1) * per_pass));
+      gl_state.uniform(uniform_iterate_input_counter, input);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, lists[input]);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, lists[1 - input]);
+      if (pass == 0) {
+        GLuint groups_x, groups_y;
+        compute_groups(pixels, gl_ext->max_compute_groups_x, groups_x,
+                       groups_y);
+        gl_ext->DispatchCompute(groups_x, groups_y, 1);
+      } else {
+        gl_ext->DispatchComputeIndirect(sizeof(GLuint[4]) * input);
+      }
+      gl_ext->MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    gl_ext->MemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                          GL_FRAMEBUFFER_BARRIER_BIT);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    // A readback still in flight keeps its copy, later passes are skipped
+    if (!compute_stats_fence) {
+      GLsizeiptr size = sizeof(GLuint) * passes;
+      glBindBuffer(GL_COPY_READ_BUFFER, counter_buffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, gl->buf_id(BUF_ID_PASS_STATS));
+      glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_READ);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                          sizeof(GLuint[8]), 0, size);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+      compute_stats_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      compute_stats_passes = passes;
+    }
+  }
+
+  void read_compute_stats() {
+    if (!compute_stats_fence ||
+        glClientWaitSync(compute_stats_fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(compute_stats_fence);
+    compute_stats_fence = nullptr;
+    compute_active.resize(compute_stats_passes);
+    glBindBuffer(GL_COPY_READ_BUFFER, gl->buf_id(BUF_ID_PASS_STATS));
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                       sizeof(GLuint) * compute_stats_passes,
+                       compute_active.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+
+  // Reads a query result without stalling, returns false while it is not
+  // available yet
+  bool poll_query(QueryId id, bool &pending, GLuint64 &result) const {
+    if (!pending) {
+      return false;
+    }
+    GLuint available;
+    glGetQueryObjectuiv(gl->query_id(id), GL_QUERY_RESULT_AVAILABLE,
+                        &available);
+    if (!available) {
+      return false;
+    }
+    glGetQueryObjectui64v(gl->query_id(id), GL_QUERY_RESULT, &result);
+    pending = false;
+    return true;
+  }
+
+  int aa_quality = 2;
+  float aa_threshold = 1.0f;
+  unsigned aa_version = 0;
+  // Incremented each time the anti-aliased data changes
+  unsigned aa_passes = 0;
+  int aa_last_quality = 0;
+  float aa_last_threshold = 0.0f;
+  bool aa_query_pending = false;
+  GLuint64 aa_pixels = 0;
+
+  // The supersampling pass evaluates the GPU kernel, so it is skipped for
+  // data computed by the CPU kernels
+  bool aa_enabled() const noexcept { return aa_quality > 0 && !cpu_kernel; }
+
+  // Texture with the iteration data that should be colorized
+  TextureId resolved_iterations() const noexcept {
+    return aa_enabled() ? TEX_ID_AA_ITERATIONS : TEX_ID_ITERATIONS;
+  }
+
+  // Copies the iteration data, then supersamples only the pixels whose
+  // neighbourhood has a high variance. An occlusion query counts them.
+  void update_aa(int width, int height) {
+    poll_query(QUERY_ID_AA_PIXELS, aa_query_pending, aa_pixels);
+    if (!aa_enabled()) {
+      if (aa_last_quality != 0) {
+        aa_last_quality = 0;
+        ++aa_passes;
+      }
+      aa_pixels = 0;
+      return;
+    }
+    if (aa_version == iteration_data_version &&
+        aa_last_quality == aa_quality && aa_last_threshold == aa_threshold) {
+      return;
+    }
+    aa_version = iteration_data_version;
+    ++aa_passes;
+    aa_last_quality = aa_quality;
+    aa_last_threshold = aa_threshold;
+
+    gl_state.bind_framebuffer(GL_READ_FRAMEBUFFER,
+                              gl->fbo_id(FBO_ID_ITERATIONS));
+    gl_state.bind_framebuffer(GL_DRAW_FRAMEBUFFER,
+                              gl->fbo_id(FBO_ID_AA_ITERATIONS));
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    bool start_query = !aa_query_pending;
+    if (start_query) {
+      glBeginQuery(GL_SAMPLES_PASSED, gl->query_id(QUERY_ID_AA_PIXELS));
+    }
+    gl_state.use_program(program(PROGRAM_ID_AA));
+    gl_state.bind_texture(0, GL_TEXTURE_2D, gl->tex_id(TEX_ID_ITERATIONS));
+    gl_state.uniform(uniform_aa_iteration_data, 0);
+    gl_state.uniform(uniform_aa_samples_per_axis, aa_quality + 1);
+    gl_state.uniform(uniform_aa_threshold, aa_threshold);
+    draw_fullscreen();
+    if (start_query) {
+      glEndQuery(GL_SAMPLES_PASSED);
+      aa_query_pending = true;
+    }
+  }
+
+  unsigned histogram_version = 0;
+  unsigned histogram_aa_passes = 0;
+  TextureId cdf_tex = TEX_ID_CDF_0;
+  bool histogram_query_pending = false;
+  float histogram_build_ms = 0.0f;
+
+  // The CDF is only rebuilt when the iteration data changes: the range of
+  // the iteration counts by blending every pixel into one texel with min
+  // and max, copied into the View block on the GPU, then the histogram over
+  // that range by scattering one point per pixel with additive blending,
+  // then an inclusive scan over the bins. Bins over [0, iterations] would
+  // put nearly every pixel of a deep view with many iterations into one.
+  void update_histogram(int width, int height) {
+    GLuint64 ns;
+    if (poll_query(QUERY_ID_HISTOGRAM, histogram_query_pending, ns)) {
+      histogram_build_ms = 1e-6f * ns;
+    }
+    if (histogram_version == iteration_data_version &&
+        histogram_aa_passes == aa_passes) {
+      return;
+    }
+    histogram_version = iteration_data_version;
+    histogram_aa_passes = aa_passes;
+
+    if (!histogram_query_pending) {
+      glBeginQuery(GL_TIME_ELAPSED, gl->query_id(QUERY_ID_HISTOGRAM));
+    }
+
+    gl_state.set_blend(true);
+    gl_state.use_program(program(PROGRAM_ID_HISTOGRAM));
+    gl_state.bind_texture(0, GL_TEXTURE_2D,
+                          gl->tex_id(resolved_iterations()));
+    gl_state.uniform(uniform_histogram_iteration_data, 0);
+    gl_state.uniform(uniform_histogram_bins, HISTOGRAM_BINS);
+    gl_state.bind_vertex_array(gl->vao_id(VAO_ID_EMPTY));
+
+    // Minimum in red, maximum in alpha
+    gl_state.viewport(0, 0, 1, 1);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER,
+                              gl->fbo_id(FBO_ID_ITERATION_RANGE));
+    glClearColor(FLT_MAX, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBlendEquationSeparate(GL_MIN, GL_MAX);
+    gl_state.uniform(uniform_histogram_range_pass, 1);
+    glDrawArrays(GL_POINTS, 0, width * height);
+    glBlendEquation(GL_FUNC_ADD);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, gl->buf_id(BUF_ID_VIEW));
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT,
+                 reinterpret_cast<void *>(
+                     offsetof(ViewUniforms, iteration_range)));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
+    gl_state.viewport(0, 0, HISTOGRAM_BINS, 1);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, gl->fbo_id(FBO_ID_HISTOGRAM));
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
+    glBlendFunc(GL_ONE, GL_ONE);
+    gl_state.uniform(uniform_histogram_range_pass, 0);
+    glDrawArrays(GL_POINTS, 0, width * height);
+    gl_state.set_blend(false);
 
-    glUseProgram(*shader_program);
-    glUniform2f(uniform_window_size, window_width, window_height);
-    glUniform2f(uniform_center, curr_center_x(), curr_center_y());
-    glUniform1f(uniform_scale, curr_scale());
-    glUniform1i(uniform_iterations, mandelbrot_iters);
+    gl_state.use_program(program(PROGRAM_ID_PREFIX_SUM));
+    gl_state.uniform(uniform_prefix_sum_values, 0);
+    TextureId src = TEX_ID_HISTOGRAM;
+    TextureId dst = TEX_ID_CDF_0;
+    for (int offset = 1; offset < HISTOGRAM_BINS; offset *= 2) {
+      FramebufferId fbo = dst == TEX_ID_CDF_0 ? FBO_ID_CDF_0 : FBO_ID_CDF_1;
+      gl_state.bind_framebuffer(GL_FRAMEBUFFER, gl->fbo_id(fbo));
+      gl_state.bind_texture(0, GL_TEXTURE_2D, gl->tex_id(src));
+      gl_state.uniform(uniform_prefix_sum_offset, offset);
+      draw_fullscreen();
+      src = dst;
+      dst = dst == TEX_ID_CDF_0 ? TEX_ID_CDF_1 : TEX_ID_CDF_0;
+    }
+    cdf_tex = src;
 
-    glBindVertexArray(gl->vao_id(VAO_ID_FULLSCREEN));
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->buf_id(BUF_ID_INDEX));
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
-    glBindVertexArray(0);
+    if (!histogram_query_pending) {
+      glEndQuery(GL_TIME_ELAPSED);
+      histogram_query_pending = true;
+    }
+  }
+
+  void draw_colorized() {
+    gl_state.use_program(program(PROGRAM_ID_COLORIZE));
+    gl_state.bind_texture(0, GL_TEXTURE_2D,
+                          gl->tex_id(resolved_iterations()));
+    gl_state.uniform(uniform_colorize_iteration_data, 0);
+    gl_state.uniform(uniform_colorize_color_mode, color_mode);
+    gl_state.bind_texture(1, GL_TEXTURE_1D, gl->tex_id(TEX_ID_PALETTE));
+    gl_state.uniform(uniform_colorize_palette, 1);
+    gl_state.uniform(uniform_colorize_palette_period, palette_period);
+    gl_state.uniform(uniform_colorize_palette_offset, palette_offset);
+    gl_state.uniform(uniform_colorize_palette_speed, palette_speed);
+    gl_state.uniform(uniform_colorize_time, 0.001f * last_frame_tick);
+    gl_state.bind_texture(2, GL_TEXTURE_2D, gl->tex_id(cdf_tex));
+    gl_state.uniform(uniform_colorize_cdf, 2);
+    gl_state.uniform(uniform_colorize_histogram_bins, HISTOGRAM_BINS);
+    draw_fullscreen();
+  }
+
+  std::optional<FrameCapture> frame_capture;
+  std::atomic<bool> screenshot_requested = false;
+  bool capture_frames = false;
+  unsigned screenshot_count = 0;
+  unsigned capture_count = 0;
+
+  // Queues a readback of the colorized frame, without the UI
+  void capture(int window_width, int window_height) {
+    frame_capture->collect();
+    char path[64];
+    if (screenshot_requested.exchange(false)) {
+      std::snprintf(path, sizeof(path), "screenshot_%04u.ppm",
+                    screenshot_count++);
+      frame_capture->read(window_width, window_height, path);
+    }
+    if (capture_frames) {
+      std::snprintf(path, sizeof(path), "capture_%06u.ppm", capture_count++);
+      frame_capture->read(window_width, window_height, path);
+    }
+  }
+
+  void redraw() {
+    gl_state.next_frame();
+#ifdef SHADER_HOT_RELOAD_DIR
+    if (shader_reloader->swap(programs, shader_sources)) {
+      init_uniforms();
+      iteration_data_valid = false;
+    }
+#endif
+
+    int window_width = this->window_width;
+    int window_height = this->window_height;
+    resize_iteration_data(window_width, window_height);
+    select_variant();
+    read_compute_stats();
+
+    sample_camera();
+    select_cpu_kernel_for_settings(window_width, window_height);
+    float s = update_render_scale();
+    int data_width = std::max(1, int(s * window_width + 0.5f));
+    int data_height = std::max(1, int(s * window_height + 0.5f));
+    update_view_uniforms(window_width, window_height, data_width,
+                         data_height);
+    gl_state.viewport(0, 0, data_width, data_height);
+    draw_fractal(data_width, data_height);
+    update_aa(rendered_width, rendered_height);
+    if (color_mode == COLOR_MODE_HISTOGRAM) {
+      update_histogram(rendered_width, rendered_height);
+    }
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    gl_state.viewport(0, 0, window_width, window_height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    draw_colorized();
+    capture(window_width, window_height);
 
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame();
     ImGui::NewFrame();
 
     ImGui::Begin("Settings");
-    ImGui::SliderInt("Iterations", &mandelbrot_iters, 1, 1024);
+    ImGui::SliderInt("Iterations", &mandelbrot_iters, 1, 1 << 24, "%d",
+                     ImGuiSliderFlags_Logarithmic);
+    ImGui::Text("Zoom: 10^%.1f", log2(curr_scale()) * std::log10(2.0));
+    if (ImGui::Button("Zoom to minibrot (N)")) {
+      nucleus_requested = true;
+    }
+    if (nucleus_locating) {
+      ImGui::SameLine();
+      ImGui::Text("Locating");
+    } else if (nucleus_period > 0) {
+      ImGui::SameLine();
+      ImGui::Text("Period %d at 10^%.1f", int(nucleus_period),
+                  double(nucleus_zoom));
+    } else if (nucleus_period == 0) {
+      ImGui::SameLine();
+      ImGui::Text("None in the view");
+    }
+    ImGui::Combo("Coloring", &color_mode,
+                 "Smooth iterations\0Distance estimate\0Palette\0"
+                 "Histogram\0");
+    if (color_mode == COLOR_MODE_PALETTE) {
+      ImGui::SliderFloat("Palette period", &palette_period, 1.0f, 512.0f);
+    }
+    if (color_mode == COLOR_MODE_HISTOGRAM) {
+      ImGui::Text("Histogram build: %.3f ms", histogram_build_ms);
+    }
+    if (color_mode == COLOR_MODE_PALETTE ||
+        color_mode == COLOR_MODE_HISTOGRAM) {
+      ImGui::SliderFloat("Palette offset", &palette_offset, 0.0f, 1.0f);
+      ImGui::SliderFloat("Palette cycles/s", &palette_speed, -2.0f, 2.0f);
+      ImGui::InputText("Palette file (PPM)", palette_path,
+                       sizeof(palette_path));
+      if (ImGui::Button("Load palette")) {
+        load_palette();
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Default palette")) {
+        upload_palette(generate_palette(256));
+      }
+    }
+    ImGui::Combo("Formula", &formula, "Mandelbrot\0Burning Ship\0Tricorn\0");
+    ImGui::SliderInt("Power", &power, CPU_MIN_POWER, CPU_MAX_POWER);
+    ImGui::Checkbox("Julia set", &julia);
+    if (julia && ImGui::InputFloat2("Julia constant", julia_c)) {
+      iteration_data_valid = false;
+    }
+    if (formula == FORMULA_MANDELBROT) {
+      ImGui::Checkbox("Interior checks", &interior_checks);
+    }
+    ImGui::Checkbox("CPU kernels", &cpu_kernels);
+    if (cpu_kernel) {
+      ImGui::Text("CPU render: %.1f ms, %u threads", cpu_render_ms,
+                  thread_pool.size());
+      ImGui::Text("CPU precision: %s",
+                  cpu_precision == CPU_PRECISION_DOUBLE  ? "double"
+                  : cpu_precision == CPU_PRECISION_FIXED ? "Q3.60 fixed point"
+                  : cpu_precision == CPU_PRECISION_PERTURBATION
+                      ? "perturbation"
+                  : cpu_kernels::has_avx2_fma() ? "double-double (AVX2/FMA)"
+                                                : "double-double");
+      if (cpu_precision == CPU_PRECISION_PERTURBATION) {
+        ImGui::Text("Reference orbit: %d iterations, %.1f ms",
+                    reference_orbit.size() - 1, reference_ms);
+        ImGui::Text("Reused for %d frames%s", reference_frames,
+                    next_reference.valid() ? ", computing the next" : "");
+        ImGui::Text("Glitches: %d pixels, %d references, %.1f ms",
+                    glitch_pixels, glitch_references, glitch_ms);
+        if (glitches_left) {
+          ImGui::Text("Uncorrected: %d pixels", glitches_left);
+        }
+        ImGui::Text("Orbit storage: %.2f bytes/iteration%s",
+                    reference_orbit.bytes_per_iteration(),
+                    reference_orbit.is_compressed() ? ", compressed" : "");
+        if (reference_orbit.is_compressed()) {
+          ImGui::Text("Regeneration: %.1f%% of the steps",
+                      cpu_stats.active_steps
+                          ? 100.0 * cpu_stats.regenerated /
+                                cpu_stats.active_steps
+                          : 0.0);
+        }
+        if (ImGui::Checkbox("Bilinear approximation",
+                            &bilinear_approximation)) {
+          iteration_data_valid = false;
+        }
+        if (bilinear_approximation) {
+          ImGui::Text("BLA: %zu levels, %.1f ms, average step %.1f",
+                      bla_table.levels.size(), bla_ms,
+                      cpu_stats.active_steps
+                          ? double(cpu_stats.iterations) /
+                                cpu_stats.active_steps
+                          : 0.0);
+        }
+      }
+      ImGui::Text("Lane occupancy: %.1f%%",
+                  cpu_stats.lane_steps ? 100.0 * cpu_stats.active_steps /
+                                             cpu_stats.lane_steps
+                                       : 0.0);
+      ImGui::Text("Upload: %s, GPU waits: %u",
+                  texture_stream->persistent() ? "persistent mapping"
+                                               : "orphaned buffers",
+                  texture_stream->waits);
+    } else {
+      if (gl_ext->gpu_shader_fp64) {
+        ImGui::Combo("Precision", &precision, "Float\0Double\0");
+      }
+      if (gl_ext->compute_shader) {
+        ImGui::Checkbox("Compute passes", &compute_passes);
+      }
+      if (compute_enabled()) {
+        if (ImGui::SliderInt("Iterations per pass", &compute_pass_iterations,
+                             1, 1024)) {
+          iteration_data_valid = false;
+        }
+        std::string active = "Pixels per pass:";
+        for (GLuint count : compute_active) {
+          active += ' ' + std::to_string(count);
+        }
+        ImGui::TextWrapped("%s", active.c_str());
+      }
+      ImGui::Text("Compiled programs: %zu", programs.size());
+    }
+    ImGui::SliderInt("AA quality", &aa_quality, 0, 4);
+    if (aa_enabled()) {
+      ImGui::SliderFloat("AA edge threshold", &aa_threshold, 0.0625f, 16.0f,
+                         "%.3f", ImGuiSliderFlags_Logarithmic);
+      ImGui::Text("Supersampled pixels: %llu",
+                  static_cast<unsigned long long>(aa_pixels));
+    }
+    ImGui::Checkbox("Dynamic resolution", &dynamic_resolution);
+    if (dynamic_resolution) {
+      ImGui::SliderFloat("Target frame time, ms", &target_frame_ms, 4.0f,
+                         100.0f);
+      ImGui::SliderFloat("Minimal resolution", &min_render_scale, 0.125f,
+                         1.0f);
+      ImGui::Text("Resolution: %dx%d (%.0f%%)", rendered_width,
+                  rendered_height, 100.0f * rendered_width / window_width);
+    }
+    if (ImGui::Button("Screenshot (F12)")) {
+      screenshot_requested = true;
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Capture frames", &capture_frames);
+    ImGui::Text("Frames written: %u, dropped: %u", frame_capture->written(),
+                frame_capture->dropped);
+    ImGui::Text("GL state calls per frame: %u issued, %u skipped",
+                gl_state.frame_issued, gl_state.frame_elided);
     ImGui::SliderInt("FPS update interval, ms", &fps_update_interval, 1, 2000);
     ImGui::SliderInt("Animation duration, ms", &transition_ticks, 1, 2000);
     ImGui::SliderFloat("Scroll coefficient", &scroll_coef, 0.125, 0.875);
+    input_transition_ticks = transition_ticks;
+    input_scroll_coef = scroll_coef;
+    input_iters = mandelbrot_iters;
+    ImGui::Text("Input latency: %.1f ms, max %.1f ms",
+                latency_queued_ms + latency_sampled_ms + latency_swapped_ms,
+                latency_max_ms);
+    if (ImGui::Checkbox("Measure latency stages", &measure_latency)) {
+      latency_max_ms = 0.0f;
+    }
+    if (measure_latency) {
+      ImGui::Text("Queued %.1f ms, to frame %.1f ms, to swap %.1f ms",
+                  latency_queued_ms, latency_sampled_ms, latency_swapped_ms);
+    }
     ImGui::End();
 
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
     SDL_GL_SwapWindow(window.get());
+    if (measure_latency) {
+      glFinish();
+    }
+    measure_input_latency();
+
+    if (startup_counter) {
+      SDL_Log("Time to first frame: %.1f ms", elapsed_ms(startup_counter));
+      startup_counter = 0;
+    }
   }
 
-  void main_loop_iteration() {
-    update_time();
-    poll_events();
-    redraw();
+  void render_loop() {
+    SDL_GL_MakeCurrent(window.get(), context.get());
+    while (is_running) {
+      update_time();
+      process_ui_events();
+      redraw();
+    }
+    SDL_GL_MakeCurrent(window.get(), nullptr);
+  }
+
+  // Events that arrived within timeout ms, if any, then the camera they
+  // moved. Runs on the thread that created the window, the only one SDL
+  // delivers events to.
+  void handle_events(Uint32 timeout) {
+    SDL_Event evt;
+    if (SDL_WaitEventTimeout(&evt, timeout)) {
+      std::lock_guard<std::mutex> lock(ui_events_mutex);
+      do {
+        handle_event(evt);
+        ui_events.push_back(evt);
+      } while (SDL_PollEvent(&evt));
+    }
+    update_nucleus();
+    publish_camera();
+    if (fps != shown_fps) {
+      shown_fps = fps;
+      std::ostringstream oss;
+      oss.setf(std::ios::fixed);
+      oss.precision(1);
+      oss << "FPS: " << shown_fps;
+      SDL_SetWindowTitle(window.get(), oss.str().c_str());
+    }
+  }
+
+  float shown_fps = 0.0f;
+
+  // ImGui's SDL backend, which runs with the UI on the render thread, calls
+  // SDL's cursor and mouse capture functions every frame. SDL only supports
+  // those on the thread that created the window, which X11 and Wayland let
+  // slide but macOS and Windows do not, so there everything runs on one
+  // thread.
+#ifdef __linux__
+  static constexpr bool THREADED_RENDERING = true;
+#else
+  static constexpr bool THREADED_RENDERING = false;
+#endif
+
+  // With THREADED_RENDERING this thread waits for input while another one
+  // owns the context and renders. A slow frame then no longer delays the
+  // camera update that follows it.
+  void run() {
+    if (!THREADED_RENDERING) {
+      while (is_running) {
+        handle_events(0);
+        update_time();
+        process_ui_events();
+        redraw();
+      }
+      return;
+    }
+    SDL_GL_MakeCurrent(window.get(), nullptr);
+    std::thread render_thread([this] { render_loop(); });
+    while (is_running) {
+      handle_events(100);
+    }
+    render_thread.join();
+    // The destructors release GL objects
+    SDL_GL_MakeCurrent(window.get(), context.get());
   }
 };
 
 std::optional<Game> game;
 
-void main_loop_iteration() { game->main_loop_iteration(); }
-
 int main(int _argc, char *_argv[]) {
   game.emplace();
-  while (game->is_running) {
-    main_loop_iteration();
-  }
+  game->run();
   return 0;
 }
@@ -0,0 +1,108 @@
+#ifndef mapped_array_hpp_INCLUDED
+#define mapped_array_hpp_INCLUDED
+
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#define MAPPED_ARRAY_MMAP
+#endif
+
+// Append-only array of plain values written to an anonymous temporary file
+// and memory-mapped once complete, so the OS pages it in and out instead of
+// it taking up memory. Where there is no mmap it is an ordinary vector.
+template <typename T> class MappedArray {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  MappedArray() = default;
+  MappedArray(const MappedArray &) = delete;
+  MappedArray &operator=(const MappedArray &) = delete;
+  MappedArray(MappedArray &&other) noexcept { swap(other); }
+  MappedArray &operator=(MappedArray &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+  ~MappedArray() { clear(); }
+
+  void clear() {
+#ifdef MAPPED_ARRAY_MMAP
+    if (mapping) {
+      munmap(mapping, count * sizeof(T));
+    }
+    if (file) {
+      std::fclose(file);
+    }
+    mapping = nullptr;
+    file = nullptr;
+#endif
+    memory.clear();
+    count = 0;
+  }
+
+  void push_back(const T &value) {
+#ifdef MAPPED_ARRAY_MMAP
+    if (!file && !(file = std::tmpfile())) {
+      throw std::runtime_error("Could not create a temporary file");
+    }
+    if (std::fwrite(&value, sizeof(T), 1, file) != 1) {
+      throw std::runtime_error("Could not write to a temporary file");
+    }
+#else
+    memory.push_back(value);
+#endif
+    ++count;
+  }
+
+  // Makes the values readable, after the last push_back
+  void map() {
+#ifdef MAPPED_ARRAY_MMAP
+    if (!file || mapping) {
+      return;
+    }
+    void *address = nullptr;
+    if (std::fflush(file) == 0) {
+      address = mmap(nullptr, count * sizeof(T), PROT_READ, MAP_SHARED,
+                     fileno(file), 0);
+    }
+    if (address == MAP_FAILED || !address) {
+      throw std::runtime_error("Could not map a temporary file");
+    }
+    mapping = static_cast<T *>(address);
+#endif
+  }
+
+  const T *data() const noexcept {
+#ifdef MAPPED_ARRAY_MMAP
+    return mapping;
+#else
+    return memory.data();
+#endif
+  }
+
+  std::size_t size() const noexcept { return count; }
+  const T &operator[](std::size_t i) const noexcept { return data()[i]; }
+
+private:
+  void swap(MappedArray &other) noexcept {
+#ifdef MAPPED_ARRAY_MMAP
+    std::swap(file, other.file);
+    std::swap(mapping, other.mapping);
+#endif
+    std::swap(memory, other.memory);
+    std::swap(count, other.count);
+  }
+
+#ifdef MAPPED_ARRAY_MMAP
+  std::FILE *file = nullptr;
+  T *mapping = nullptr;
+#endif
+  std::vector<T> memory;
+  std::size_t count = 0;
+};
+
+#endif // mapped_array_hpp_INCLUDED
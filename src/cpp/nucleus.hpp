@@ -0,0 +1,209 @@
+#ifndef nucleus_hpp_INCLUDED
+#define nucleus_hpp_INCLUDED
+
+#include "big_fixed.hpp"
+#include "float_exp.hpp"
+#include "reference_orbit.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Minibrot found from a view: its nucleus, the point of the period p where
+// z_p = 0, and its size, its scale against the whole set around 0.
+// The orbit of the nucleus is periodic, so as a reference it never escapes
+// and perturbed pixels around it never glitch.
+struct Nucleus {
+  BigFixed x;
+  BigFixed y;
+  // 0 where none was found
+  int period = 0;
+  FloatExp size;
+};
+
+namespace nucleus {
+
+constexpr int MAX_NEWTON_STEPS = 64;
+// Boxes tried, each a quarter of the one before
+constexpr int BOXES = 8;
+// Orbits of points that near the nucleus stay well within this
+constexpr double ESCAPE = 0x1p16;
+
+inline FloatExp magnitude(FloatExp x, FloatExp y) {
+  int e = std::max(x.exponent, y.exponent);
+  return {std::hypot(std::ldexp(x.mantissa, x.exponent - e),
+                     std::ldexp(y.mantissa, y.exponent - e)),
+          e};
+}
+
+// Whether the polygon through the points in order winds around 0, from
+// the crossings of the positive real axis
+inline bool surrounds_origin(const FloatExp *x, const FloatExp *y, int n) {
+  bool inside = false;
+  for (int i = 0, j = n - 1; i < n; j = i++) {
+    bool above_i = y[i].mantissa > 0.0, above_j = y[j].mantissa > 0.0;
+    if (above_i != above_j) {
+      // The edge from j to i crosses at (x_j y_i - y_j x_i) / (y_i - y_j)
+      FloatExp cross = x[j] * y[i] - y[j] * x[i];
+      FloatExp dy = y[i] - y[j];
+      if ((cross.mantissa > 0.0) == (dy.mantissa > 0.0)) {
+        inside = !inside;
+      }
+    }
+  }
+  return inside;
+}
+
+// Lowest period at which the corners of the box of half sizes rx, ry
+// around the point of the orbit, iterated, surround 0, so that the box
+// holds a nucleus of that period. The corners are perturbed from the
+// orbit. 0 where the orbit ends first. Corners that escaped may report a
+// period without a nucleus, which Newton's method then fails to find.
+inline int box_period(const ReferenceOrbit &orbit, FloatExp rx, FloatExp ry,
+                      const std::atomic<bool> *stop = nullptr) {
+  const FloatExp dcx[4] = {-rx, rx, rx, -rx};
+  const FloatExp dcy[4] = {-ry, -ry, ry, ry};
+  FloatExp dzx[4], dzy[4], zx[4], zy[4];
+  OrbitReader reader(orbit);
+  // Z_{m - 1}
+  double px = 0.0, py = 0.0;
+  for (int m = 1; m < orbit.size(); ++m) {
+    if (stop && m % 1024 == 0 && *stop) {
+      return 0;
+    }
+    if (m >= reader.end) {
+      reader.load(reader.window_of(m));
+    }
+    double x = reader.x[m - reader.begin];
+    double y = reader.y[m - reader.begin];
+    for (int i = 0; i < 4; ++i) {
+      // dz' = (2Z + dz) dz + dc
+      FloatExp ax = FloatExp(2.0 * px) + dzx[i];
+      FloatExp ay = FloatExp(2.0 * py) + dzy[i];
+      FloatExp next_x = ax * dzx[i] - ay * dzy[i] + dcx[i];
+      dzy[i] = ax * dzy[i] + ay * dzx[i] + dcy[i];
+      dzx[i] = next_x;
+      zx[i] = FloatExp(x) + dzx[i];
+      zy[i] = FloatExp(y) + dzy[i];
+    }
+    if (surrounds_origin(zx, zy, 4)) {
+      return m;
+    }
+    px = x;
+    py = y;
+  }
+  return 0;
+}
+
+// Newton's method on z_p(c) = 0 from the point of the nucleus, in its
+// precision. z is iterated in BigFixed and the derivative dz_p/dc in
+// FloatExp, which only has to be close for the steps to converge. Each
+// pass also estimates the size as 1 / |b l^2|, with l the product of 2z_i
+// and b the sum of 1 / l over i = 1 .. p - 1.
+inline bool newton_nucleus(Nucleus &nucleus,
+                           const std::atomic<bool> *stop = nullptr) {
+  int limbs = nucleus.x.fraction_limbs();
+  for (int step = 0; step < MAX_NEWTON_STEPS; ++step) {
+    BigFixed zx(limbs), zy(limbs);
+    FloatExp dx, dy;
+    FloatExp lx = 1.0, ly;
+    FloatExp bx = 1.0, by;
+    for (int i = 0; i < nucleus.period; ++i) {
+      if (stop && *stop) {
+        return false;
+      }
+      double x = zx.to_double(), y = zy.to_double();
+      if (x * x + y * y > ESCAPE) {
+        return false;
+      }
+      // dz/dc' = 2z dz/dc + 1
+      FloatExp tx = 2.0 * x, ty = 2.0 * y;
+      FloatExp next_dx = tx * dx - ty * dy + FloatExp(1.0);
+      dy = tx * dy + ty * dx;
+      dx = next_dx;
+      if (i > 0) {
+        FloatExp next_lx = tx * lx - ty * ly;
+        ly = tx * ly + ty * lx;
+        lx = next_lx;
+        FloatExp l2 = lx * lx + ly * ly;
+        bx = bx + lx / l2;
+        by = by - ly / l2;
+      }
+      BigFixed xy = zx * zy;
+      zx = zx * zx - zy * zy + nucleus.x;
+      zy = xy + xy + nucleus.y;
+    }
+    // l^2 b
+    FloatExp qx = lx * lx - ly * ly, qy = FloatExp(2.0) * lx * ly;
+    nucleus.size = FloatExp(1.0) / magnitude(qx * bx - qy * by,
+                                             qx * by + qy * bx);
+    // z_p / (dz_p/dc)
+    FloatExp px = zx.to_float_exp(), py = zy.to_float_exp();
+    FloatExp d2 = dx * dx + dy * dy;
+    FloatExp sx = (px * dx + py * dy) / d2;
+    FloatExp sy = (py * dx - px * dy) / d2;
+    nucleus.x = nucleus.x - BigFixed::from_double(sx.mantissa, sx.exponent,
+                                                  limbs);
+    nucleus.y = nucleus.y - BigFixed::from_double(sy.mantissa, sy.exponent,
+                                                  limbs);
+    // Far closer than the size, or down to the precision
+    FloatExp moved = magnitude(sx, sy);
+    if (moved < nucleus.size * FloatExp(0x1p-48) ||
+        log2(moved) < -64.0 * limbs + 32.0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Bits below the size that place the nucleus for views of the minibrot
+inline int fraction_limbs_for_size(FloatExp size) {
+  return BigFixed::limbs_for_bits(std::max(0, -int(log2(size))) + 96);
+}
+
+} // namespace nucleus
+
+// Minibrot of the lowest period with its nucleus in the box of half sizes
+// rx, ry around (cx, cy), from the box period of the corners perturbed from
+// the orbit of the middle, which goes up to the iterations, and Newton's
+// method from the middle. Newton continues in more precision where the
+// size turns out to need it. Where it fails or lands outside of the box,
+// smaller boxes around the middle are tried. Returns a period of 0 where
+// none of them holds a nucleus.
+inline Nucleus locate_nucleus(const BigFixed &cx, const BigFixed &cy,
+                              FloatExp rx, FloatExp ry, int iterations,
+                              const std::atomic<bool> *stop = nullptr) {
+  ReferenceOrbit orbit;
+  orbit.compute(cx, cy, iterations, nucleus::ESCAPE, stop);
+  for (int box = 0; box < nucleus::BOXES; ++box) {
+    Nucleus result;
+    result.period = nucleus::box_period(orbit, rx, ry, stop);
+    result.x = cx;
+    result.y = cy;
+    int limbs = nucleus::fraction_limbs_for_size(std::min(rx, ry));
+    bool found = result.period != 0;
+    while (found) {
+      result.x.set_fraction_limbs(limbs);
+      result.y.set_fraction_limbs(limbs);
+      found = nucleus::newton_nucleus(result, stop);
+      int needed = nucleus::fraction_limbs_for_size(result.size);
+      if (needed <= limbs) {
+        break;
+      }
+      limbs = needed;
+    }
+    if (found &&
+        !(FloatExp(2.0) * rx < abs((result.x - cx).to_float_exp())) &&
+        !(FloatExp(2.0) * ry < abs((result.y - cy).to_float_exp()))) {
+      return result;
+    }
+    if (stop && *stop) {
+      break;
+    }
+    rx = ldexp(rx, -2);
+    ry = ldexp(ry, -2);
+  }
+  return {};
+}
+
+#endif // nucleus_hpp_INCLUDED
@@ -0,0 +1,69 @@
+#ifndef palette_hpp_INCLUDED
+#define palette_hpp_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Palettes are stored as tightly packed RGB8 triples
+using Palette = std::vector<std::uint8_t>;
+
+// Cosine gradient, see https://iquilezles.org/articles/palettes/
+inline Palette generate_palette(int size) {
+  static constexpr double PI = 3.14159265358979323846;
+  static constexpr double phase[] = {0.0, 0.10, 0.20};
+
+  Palette palette(3 * size);
+  for (int i = 0; i < size; ++i) {
+    double t = double(i) / size;
+    for (int c = 0; c < 3; ++c) {
+      double v = 0.5 + 0.5 * std::cos(2.0 * PI * (t + phase[c]));
+      palette[3 * i + c] = static_cast<std::uint8_t>(255.0 * v + 0.5);
+    }
+  }
+  return palette;
+}
+
+// Loads a binary PPM (P6) image, taking its pixels in row-major order as the
+// palette entries. Any W x H image works, a single row is the usual case.
+inline Palette load_palette_ppm(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Could not open palette file " + path);
+  }
+
+  std::string magic;
+  int width = 0, height = 0, max_value = 0;
+  in >> magic;
+  auto skip_comments = [&in] {
+    in >> std::ws;
+    while (in.peek() == '#') {
+      std::string comment;
+      std::getline(in, comment);
+      in >> std::ws;
+    }
+  };
+  skip_comments();
+  in >> width;
+  skip_comments();
+  in >> height;
+  skip_comments();
+  in >> max_value;
+  in.get();
+  if (!in || magic != "P6" || width <= 0 || height <= 0 || max_value != 255) {
+    throw std::runtime_error("Palette file " + path +
+                             " is not an 8-bit binary PPM");
+  }
+
+  Palette palette(3 * std::size_t(width) * height);
+  in.read(reinterpret_cast<char *>(palette.data()), palette.size());
+  if (!in) {
+    throw std::runtime_error("Palette file " + path + " is truncated");
+  }
+  return palette;
+}
+
+#endif // palette_hpp_INCLUDED
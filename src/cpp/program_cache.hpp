@@ -0,0 +1,134 @@
+#ifndef program_cache_hpp_INCLUDED
+#define program_cache_hpp_INCLUDED
+
+#include "gl.hpp"
+#include "gl_ext.hpp"
+
+#include <SDL.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Linked program binaries stored in the user's preference directory. The
+// file name is a hash of the driver identification and of all sources, so a
+// driver update or a shader change simply misses the cache.
+struct ProgramCache {
+  explicit ProgramCache(const GLExtensions &ext) : ext(ext) {
+    if (!ext.program_binary) {
+      SDL_Log("Program binaries are not supported, the cache is disabled");
+      return;
+    }
+    if (char *pref_path = SDL_GetPrefPath("asurkis", "hw01")) {
+      directory = pref_path;
+      SDL_free(pref_path);
+    }
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      const GLubyte *str = glGetString(name);
+      driver_hash = fnv1a(str ? reinterpret_cast<const char *>(str) : "",
+                          driver_hash);
+    }
+  }
+
+  int hits = 0;
+  int misses = 0;
+
+  ShaderProgram build(const std::vector<ShaderProgram::Source> &sources) {
+    if (directory.empty()) {
+      return ShaderProgram(sources);
+    }
+
+    std::uint64_t hash = driver_hash;
+    for (const ShaderProgram::Source &src : sources) {
+      hash = fnv1a(&src.type, sizeof(src.type), hash);
+      hash = fnv1a(src.source, hash);
+      hash = fnv1a(src.defines ? src.defines : "", hash);
+      hash = fnv1a(src.version ? src.version : "", hash);
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "program_%016llx.bin",
+                  static_cast<unsigned long long>(hash));
+    std::string path = directory + name;
+
+    {
+      ShaderProgram program;
+      if (load(program, path)) {
+        ++hits;
+        return program;
+      }
+    }
+    ++misses;
+
+    // A failed glProgramBinary leaves the program unusable for linking on
+    // some drivers, start over with a fresh one
+    ShaderProgram program;
+    ext.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    program.link(sources);
+    if (program.is_linked()) {
+      store(program, path);
+    }
+    return program;
+  }
+
+private:
+  const GLExtensions &ext;
+  std::string directory;
+  std::uint64_t driver_hash = 0xcbf29ce484222325ull;
+
+  static std::uint64_t fnv1a(const void *data, std::size_t size,
+                             std::uint64_t hash) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  static std::uint64_t fnv1a(const char *str, std::uint64_t hash) {
+    return fnv1a(str, std::strlen(str), hash);
+  }
+
+  bool load(const ShaderProgram &program, const std::string &path) const {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      return false;
+    }
+    GLenum format;
+    in.read(reinterpret_cast<char *>(&format), sizeof(format));
+    std::vector<char> binary{std::istreambuf_iterator<char>(in),
+                             std::istreambuf_iterator<char>()};
+    if (binary.empty()) {
+      return false;
+    }
+    ext.ProgramBinary(program, format, binary.data(), binary.size());
+    if (!program.is_linked()) {
+      SDL_Log("Rejected cached program %s", path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  void store(const ShaderProgram &program, const std::string &path) const {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+      return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    ext.GetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    out.write(binary.data(), binary.size());
+    if (!out) {
+      SDL_Log("Could not write cached program %s", path.c_str());
+    }
+  }
+};
+
+#endif // program_cache_hpp_INCLUDED
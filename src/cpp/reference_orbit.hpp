@@ -0,0 +1,285 @@
+#ifndef reference_orbit_hpp_INCLUDED
+#define reference_orbit_hpp_INCLUDED
+
+#include "big_fixed.hpp"
+#include "mapped_array.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Iteration of a compressed orbit where its regeneration continues from the
+// stored value instead of its own
+struct OrbitWaypoint {
+  std::int64_t iteration;
+  double x;
+  double y;
+};
+
+// Mandelbrot orbit Z of a point in or near a deep view, computed in
+// BigFixed and rounded to double, which is all the perturbed pixels need of
+// it. Starts with Z_0 = 0 and ends once the orbit escapes or after the
+// iteration count.
+//
+// Orbits longer than MAX_STORED are compressed instead: Z' = Z^2 + c
+// iterated in double from the previous value stays within TOLERANCE of the
+// exact orbit for a while, so only the waypoints where it drifts further
+// are kept, in a memory-mapped file. Each WINDOW starts with a waypoint, so
+// OrbitReader regenerates any of them on its own.
+//
+// The orbit of a nucleus of period p comes back to Z_p = 0, so it only
+// needs one period: pixels that reach its end continue from its start like
+// those that pass close to 0, and it never runs out.
+struct ReferenceOrbit {
+  // 64 MiB of doubles
+  static constexpr int MAX_STORED = 1 << 22;
+  static constexpr int WINDOW = 1 << 16;
+  static constexpr double TOLERANCE = 0x1p-40;
+
+  // Whole orbit, empty when compressed
+  std::vector<double> x;
+  std::vector<double> y;
+  MappedArray<OrbitWaypoint> waypoints;
+  // The point, and rounded to double, which regenerates compressed orbits
+  BigFixed cx;
+  BigFixed cy;
+  double cx_double = 0.0;
+  double cy_double = 0.0;
+  bool escaped = false;
+  bool periodic = false;
+
+  // Stops early with a shorter orbit once stop is set
+  void compute(const BigFixed &cx, const BigFixed &cy, int iterations,
+               double bailout, const std::atomic<bool> *stop = nullptr,
+               int max_stored = MAX_STORED) {
+    x.clear();
+    y.clear();
+    waypoints.clear();
+    length = 0;
+    compressed = iterations + 1 > max_stored;
+    this->cx = cx;
+    this->cy = cy;
+    cx_double = cx.to_double();
+    cy_double = cy.to_double();
+    escaped = false;
+    periodic = false;
+    append(0.0, 0.0);
+    BigFixed zx(cx.fraction_limbs());
+    BigFixed zy(cy.fraction_limbs());
+    for (int n = 0; n < iterations; ++n) {
+      if (stop && n % 1024 == 0 && *stop) {
+        break;
+      }
+      BigFixed xy = zx * zy;
+      zx = zx * zx - zy * zy + cx;
+      zy = xy + xy + cy;
+      double rx = zx.to_double();
+      double ry = zy.to_double();
+      append(rx, ry);
+      if (rx * rx + ry * ry > bailout) {
+        escaped = true;
+        break;
+      }
+    }
+    waypoints.map();
+  }
+
+  // One period of the orbit of a nucleus, in the precision it was located
+  // in
+  void compute_periodic(const BigFixed &cx, const BigFixed &cy, int period,
+                        double bailout,
+                        const std::atomic<bool> *stop = nullptr) {
+    compute(cx, cy, period, bailout, stop);
+    periodic = !escaped && length == period + 1;
+  }
+
+  int size() const noexcept { return length; }
+
+  // Whether it covers the iterations or escaped before. Pixels outlasting
+  // it continue from its start, which loses their precision unless they
+  // escape soon after.
+  bool reaches(int iterations) const noexcept {
+    return escaped || periodic || length > iterations;
+  }
+  bool is_compressed() const noexcept { return compressed; }
+
+  double bytes_per_iteration() const noexcept {
+    if (!compressed) {
+      return 2 * sizeof(double);
+    }
+    return double(waypoints.size() * sizeof(OrbitWaypoint)) / length;
+  }
+
+  // The step regeneration takes, the same in the compression and the reader
+  static void regenerate(double &x, double &y, double cx, double cy) {
+    double xy = x * y;
+    x = x * x - y * y + cx;
+    y = xy + xy + cy;
+  }
+
+  // Z_first .. Z_last - 1 of a compressed orbit, where first starts a
+  // window
+  void regenerate_range(int first, int last, double *rx, double *ry) const {
+    const OrbitWaypoint *waypoints_end = waypoints.data() + waypoints.size();
+    const OrbitWaypoint *waypoint = std::lower_bound(
+        waypoints.data(), waypoints_end, first,
+        [](const OrbitWaypoint &w, int n) { return w.iteration < n; });
+    double zx = 0.0, zy = 0.0;
+    for (int n = first; n < last; ++n) {
+      if (waypoint != waypoints_end && waypoint->iteration == n) {
+        zx = waypoint->x;
+        zy = waypoint->y;
+        ++waypoint;
+      } else {
+        regenerate(zx, zy, cx_double, cy_double);
+      }
+      rx[n - first] = zx;
+      ry[n - first] = zy;
+    }
+  }
+
+private:
+  void append(double rx, double ry) {
+    if (!compressed) {
+      x.push_back(rx);
+      y.push_back(ry);
+    } else {
+      bool keep = length % WINDOW == 0;
+      if (!keep) {
+        regenerate(gx, gy, cx_double, cy_double);
+        double ex = gx - rx, ey = gy - ry;
+        keep = ex * ex + ey * ey > TOLERANCE * TOLERANCE * (rx * rx + ry * ry);
+      }
+      if (keep) {
+        waypoints.push_back({length, rx, ry});
+        gx = rx;
+        gy = ry;
+      }
+    }
+    ++length;
+  }
+
+  int length = 0;
+  bool compressed = false;
+  // Regenerated orbit while compressing
+  double gx = 0.0;
+  double gy = 0.0;
+};
+
+// Start of a compressed orbit regenerated once and shared read-only by
+// the readers of all threads, so that they do not regenerate it again for
+// every call. Every pixel goes through the first windows, and pixels that
+// continue from the start of the orbit go through them again, so those are
+// the ones kept, up to MAX_SHARED iterations.
+struct OrbitWindows {
+  // 256 MiB of doubles
+  static constexpr int MAX_SHARED = 1 << 24;
+
+  std::vector<double> x;
+  std::vector<double> y;
+
+  // Sizes the buffers for the orbit, empty unless it is compressed, and
+  // returns how many windows regenerate() then has to fill. Windows are
+  // independent, so they can be filled in parallel.
+  int assign(const ReferenceOrbit &orbit) {
+    this->orbit = &orbit;
+    int size = orbit.is_compressed() ? std::min(orbit.size(), MAX_SHARED) : 0;
+    x.assign(size, 0.0);
+    y.assign(size, 0.0);
+    return (size + ReferenceOrbit::WINDOW - 1) / ReferenceOrbit::WINDOW;
+  }
+
+  void regenerate(int window) {
+    int first = window * ReferenceOrbit::WINDOW;
+    int last = std::min(first + ReferenceOrbit::WINDOW, size());
+    orbit->regenerate_range(first, last, x.data() + first, y.data() + first);
+  }
+
+  int size() const noexcept { return int(x.size()); }
+
+private:
+  const ReferenceOrbit *orbit = nullptr;
+};
+
+// Window [begin, end) of a reference orbit, Z_m is x[m - begin]. A stored
+// orbit is a single window, compressed ones are read from the shared
+// windows where given and otherwise regenerated a WINDOW at a time into a
+// few cached buffers.
+class OrbitReader {
+public:
+  const double *x = nullptr;
+  const double *y = nullptr;
+  int begin = 0;
+  int end = 0;
+  // Iterations regenerated so far
+  std::uint64_t regenerated = 0;
+
+  // shared, if any, has to be assigned the same orbit
+  explicit OrbitReader(const ReferenceOrbit &orbit,
+                       const OrbitWindows *shared = nullptr)
+      : orbit(orbit), shared(shared) {
+    if (!orbit.is_compressed()) {
+      x = orbit.x.data();
+      y = orbit.y.data();
+      end = orbit.size();
+    }
+  }
+
+  int window_of(int m) const noexcept {
+    return orbit.is_compressed() ? m / ReferenceOrbit::WINDOW : 0;
+  }
+
+  void load(int window) {
+    if (!orbit.is_compressed()) {
+      return;
+    }
+    begin = window * ReferenceOrbit::WINDOW;
+    end = std::min(begin + ReferenceOrbit::WINDOW, orbit.size());
+    if (shared && end <= shared->size()) {
+      x = shared->x.data() + begin;
+      y = shared->y.data() + begin;
+      return;
+    }
+    Slot *slot = std::find_if(slots, slots + SLOTS, [&](const Slot &s) {
+      return s.window == window;
+    });
+    if (slot == slots + SLOTS) {
+      slot = std::min_element(slots, slots + SLOTS,
+                              [](const Slot &a, const Slot &b) {
+                                return a.used < b.used;
+                              });
+      regenerate(window, *slot);
+    }
+    slot->used = ++clock;
+    x = slot->x.data();
+    y = slot->y.data();
+  }
+
+private:
+  static constexpr int SLOTS = 4;
+
+  struct Slot {
+    int window = -1;
+    std::uint64_t used = 0;
+    std::vector<double> x;
+    std::vector<double> y;
+  };
+
+  void regenerate(int window, Slot &slot) {
+    int first = window * ReferenceOrbit::WINDOW;
+    int last = std::min(first + ReferenceOrbit::WINDOW, orbit.size());
+    slot.window = window;
+    slot.x.resize(last - first);
+    slot.y.resize(last - first);
+    orbit.regenerate_range(first, last, slot.x.data(), slot.y.data());
+    regenerated += last - first;
+  }
+
+  const ReferenceOrbit &orbit;
+  const OrbitWindows *shared;
+  Slot slots[SLOTS];
+  std::uint64_t clock = 0;
+};
+
+#endif // reference_orbit_hpp_INCLUDED
@@ -0,0 +1,183 @@
+#ifndef shader_reload_hpp_INCLUDED
+#define shader_reload_hpp_INCLUDED
+
+// Development mode: watches the GLSL sources and rebuilds every instantiated
+// program on a background thread with its own shared GL context. Enabled with
+// the HW01_SHADER_HOT_RELOAD CMake option, release builds use the embedded
+// sources only.
+
+#include "gl.hpp"
+#include "raii.hpp"
+#include "shaders.hpp"
+
+#include <SDL.h>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+struct ShaderReloader {
+  // Must be called on the thread owning the current context, which the new
+  // context shares its objects with
+  ShaderReloader(SDL_Window *main_window, SDL_GLContext main_context,
+                 std::string directory)
+      : directory(std::move(directory)) {
+    // A context can not be current on two threads through the same window
+    // surface, so the loader gets a hidden one
+    window = PWindow(SDL_CreateWindow("", SDL_WINDOWPOS_UNDEFINED,
+                                      SDL_WINDOWPOS_UNDEFINED, 1, 1,
+                                      SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN));
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    context = PGLContext(SDL_GL_CreateContext(window.get()));
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(main_window, main_context);
+    if (!window || !context) {
+      throw std::runtime_error("Could not create the shader loader context");
+    }
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, this->directory.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+      throw std::runtime_error("Could not watch " + this->directory);
+    }
+    SDL_Log("Watching %s for shader changes", this->directory.c_str());
+    thread = std::thread([this] { run(); });
+  }
+
+  ~ShaderReloader() {
+    stop = true;
+    thread.join();
+    close(inotify_fd);
+  }
+
+  ShaderReloader(const ShaderReloader &) = delete;
+  ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+  // Registers a program built by the main thread to be rebuilt on changes
+  void watch(ProgramKey key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    keys.insert(key);
+  }
+
+  // Non-blocking, to be called between frames. Replaces the programs and the
+  // sources later variants are built from once a complete rebuilt set is
+  // ready on the GPU and returns true.
+  bool swap(std::map<ProgramKey, ShaderProgram> &programs,
+            std::string (&sources)[SHADER_TOTAL]) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock || !ready) {
+      return false;
+    }
+    if (glClientWaitSync(ready->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      return false;
+    }
+    glDeleteSync(ready->fence);
+    for (auto &[key, program] : ready->programs) {
+      programs.insert_or_assign(key, std::move(program));
+    }
+    for (int id = 0; id < SHADER_TOTAL; ++id) {
+      sources[id] = std::move(ready->sources[id]);
+    }
+    ready.reset();
+    SDL_Log("Reloaded shader programs");
+    return true;
+  }
+
+private:
+  struct Rebuilt {
+    std::map<ProgramKey, ShaderProgram> programs;
+    std::string sources[SHADER_TOTAL];
+    GLsync fence;
+  };
+
+  std::string directory;
+  PWindow window;
+  PGLContext context;
+  int inotify_fd = -1;
+  std::atomic<bool> stop = false;
+  std::thread thread;
+  std::mutex mutex;
+  std::set<ProgramKey> keys;
+  std::optional<Rebuilt> ready;
+
+  void run() {
+    SDL_GL_MakeCurrent(window.get(), context.get());
+    while (!stop) {
+      if (wait_for_changes()) {
+        rebuild();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ready) {
+        glDeleteSync(ready->fence);
+        ready.reset();
+      }
+    }
+    SDL_GL_MakeCurrent(window.get(), nullptr);
+  }
+
+  bool wait_for_changes() const {
+    pollfd pfd = {inotify_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) {
+      return false;
+    }
+    // Editors tend to write a file in several steps, wait for them to settle
+    SDL_Delay(50);
+    alignas(inotify_event) char buffer[4096];
+    while (read(inotify_fd, buffer, sizeof(buffer)) > 0) {
+    }
+    return true;
+  }
+
+  void rebuild() {
+    Rebuilt rebuilt;
+    const char *source_ptrs[SHADER_TOTAL];
+    for (int id = 0; id < SHADER_TOTAL; ++id) {
+      std::ifstream in(directory + "/" + SHADER_FILE_NAMES[id]);
+      std::ostringstream oss;
+      oss << in.rdbuf();
+      rebuilt.sources[id] = oss.str();
+      source_ptrs[id] = rebuilt.sources[id].c_str();
+    }
+    std::set<ProgramKey> keys_snapshot;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      keys_snapshot = keys;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (ProgramKey key : keys_snapshot) {
+      ShaderProgram &program = rebuilt.programs[key];
+      program.link(program_sources(key, source_ptrs));
+      if (!program.is_linked()) {
+        SDL_Log("Shader reload failed, keeping the previous programs");
+        return;
+      }
+    }
+    rebuilt.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    SDL_Log("Shaders rebuilt in %.1f ms",
+            1000.0 * (SDL_GetPerformanceCounter() - start) /
+                SDL_GetPerformanceFrequency());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready) {
+      glDeleteSync(ready->fence);
+    }
+    ready.emplace(std::move(rebuilt));
+  }
+};
+
+#endif // shader_reload_hpp_INCLUDED
@@ -0,0 +1,159 @@
+#ifndef shaders_hpp_INCLUDED
+#define shaders_hpp_INCLUDED
+
+#include "gl.hpp"
+#include "gl_ext.hpp"
+#include "shader_sources.hpp"
+
+#include <algorithm>
+#include <vector>
+
+enum ShaderId {
+  SHADER_ID_VERT = 0,
+  SHADER_ID_FRAG,
+  SHADER_ID_MANDELBROT,
+  SHADER_ID_AA,
+  SHADER_ID_COLORIZE,
+  SHADER_ID_HISTOGRAM_VERT,
+  SHADER_ID_HISTOGRAM_FRAG,
+  SHADER_ID_PREFIX_SUM,
+  SHADER_ID_ITERATE,
+  SHADER_ID_DISPATCH,
+  SHADER_TOTAL
+};
+
+// Names of the files in src/glsl the shaders are embedded from
+constexpr const char *SHADER_FILE_NAMES[SHADER_TOTAL] = {
+    "shader.vert",    "shader.frag",    "mandelbrot.glsl",
+    "aa.frag",        "colorize.frag",  "histogram.vert",
+    "histogram.frag", "prefix_sum.frag", "iterate.comp",
+    "dispatch.comp",
+};
+
+constexpr const char *EMBEDDED_SHADER_SOURCES[SHADER_TOTAL] = {
+    SRC_VERT_SHADER,           SRC_FRAG_SHADER,
+    SRC_MANDELBROT_SHADER,     SRC_AA_SHADER,
+    SRC_COLORIZE_SHADER,       SRC_HISTOGRAM_VERT_SHADER,
+    SRC_HISTOGRAM_FRAG_SHADER, SRC_PREFIX_SUM_SHADER,
+    SRC_ITERATE_SHADER,        SRC_DISPATCH_SHADER,
+};
+
+// std140 layout of the View uniform block declared by the shaders
+struct ViewUniforms {
+  GLfloat window_size[2];
+  GLfloat data_size[2];
+  GLfloat center[2];
+  GLfloat center_lo[2];
+  GLfloat scale;
+  GLfloat scale_lo;
+  GLint iterations;
+  GLint padding;
+  // Written on the GPU by the histogram pass, never uploaded
+  GLfloat iteration_range[4];
+};
+
+constexpr GLuint VIEW_BLOCK_BINDING = 0;
+
+enum ProgramId {
+  PROGRAM_ID_FRACTAL = 0,
+  PROGRAM_ID_AA,
+  PROGRAM_ID_COLORIZE,
+  PROGRAM_ID_HISTOGRAM,
+  PROGRAM_ID_PREFIX_SUM,
+  PROGRAM_ID_ITERATE,
+  PROGRAM_ID_DISPATCH,
+  PROGRAM_TOTAL
+};
+
+struct ProgramStage {
+  GLenum type;
+  ShaderId shader;
+};
+
+// Programs running the escape-time kernel are compiled per shader variant,
+// the others only once
+constexpr bool is_variant_program(ProgramId id) {
+  return id == PROGRAM_ID_FRACTAL || id == PROGRAM_ID_AA ||
+         id == PROGRAM_ID_ITERATE;
+}
+
+// Need GL 4.3, see GLExtensions::compute_shader
+constexpr bool is_compute_program(ProgramId id) {
+  return id == PROGRAM_ID_ITERATE || id == PROGRAM_ID_DISPATCH;
+}
+
+// Compute stages need GLSL 4.30, shared sources declaring an older version
+// are compiled with this one instead when linked into them
+constexpr const char *COMPUTE_GLSL_VERSION = "#version 430 core\n";
+
+// Local size of iterate.comp
+constexpr GLuint COMPUTE_GROUP_SIZE = 64;
+
+// Work groups over count invocations, in rows of at most max_groups_x
+// since a dispatch may be as long as only 65535 groups along x. The same
+// split is in dispatch.comp.
+inline void compute_groups(GLuint count, GLuint max_groups_x,
+                           GLuint &groups_x, GLuint &groups_y) {
+  GLuint groups = (count + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE;
+  groups_x = std::max(std::min(groups, max_groups_x), 1u);
+  groups_y = (groups + groups_x - 1) / groups_x;
+}
+// Upper bound of the std430 size of PixelState in iterate.comp, reached in
+// double precision
+constexpr GLsizeiptr COMPUTE_PIXEL_STATE_SIZE = 48;
+
+constexpr unsigned shader_variant(VariantPrecision precision,
+                                  VariantFormula formula,
+                                  VariantColoring coloring,
+                                  VariantInterior interior) {
+  return ((precision * FORMULA_TOTAL + formula) * COLORING_TOTAL + coloring) *
+             INTERIOR_TOTAL +
+         interior;
+}
+
+struct ProgramKey {
+  ProgramId id;
+  unsigned variant;
+
+  bool operator<(const ProgramKey &other) const noexcept {
+    return id != other.id ? id < other.id : variant < other.variant;
+  }
+};
+
+inline const std::vector<ProgramStage> &program_stages(ProgramId id) {
+  static const std::vector<ProgramStage> stages[PROGRAM_TOTAL] = {
+      {{GL_VERTEX_SHADER, SHADER_ID_VERT},
+       {GL_FRAGMENT_SHADER, SHADER_ID_FRAG},
+       {GL_FRAGMENT_SHADER, SHADER_ID_MANDELBROT}},
+      {{GL_VERTEX_SHADER, SHADER_ID_VERT},
+       {GL_FRAGMENT_SHADER, SHADER_ID_AA},
+       {GL_FRAGMENT_SHADER, SHADER_ID_MANDELBROT}},
+      {{GL_VERTEX_SHADER, SHADER_ID_VERT},
+       {GL_FRAGMENT_SHADER, SHADER_ID_COLORIZE}},
+      {{GL_VERTEX_SHADER, SHADER_ID_HISTOGRAM_VERT},
+       {GL_FRAGMENT_SHADER, SHADER_ID_HISTOGRAM_FRAG}},
+      {{GL_VERTEX_SHADER, SHADER_ID_VERT},
+       {GL_FRAGMENT_SHADER, SHADER_ID_PREFIX_SUM}},
+      {{GL_COMPUTE_SHADER, SHADER_ID_ITERATE},
+       {GL_COMPUTE_SHADER, SHADER_ID_MANDELBROT}},
+      {{GL_COMPUTE_SHADER, SHADER_ID_DISPATCH}},
+  };
+  return stages[id];
+}
+
+// sources is indexed by ShaderId
+inline std::vector<ShaderProgram::Source>
+program_sources(ProgramKey key, const char *const *sources) {
+  const char *defines = is_variant_program(key.id)
+                            ? SHADER_VARIANT_DEFINES[key.variant]
+                            : nullptr;
+  std::vector<ShaderProgram::Source> result;
+  for (const ProgramStage &stage : program_stages(key.id)) {
+    const char *version =
+        stage.type == GL_COMPUTE_SHADER ? COMPUTE_GLSL_VERSION : nullptr;
+    result.push_back({stage.type, sources[stage.shader], defines, version});
+  }
+  return result;
+}
+
+#endif // shaders_hpp_INCLUDED
@@ -0,0 +1,140 @@
+#ifndef texture_stream_hpp_INCLUDED
+#define texture_stream_hpp_INCLUDED
+
+#include "gl.hpp"
+#include "gl_ext.hpp"
+
+#include <SDL.h>
+#include <cstddef>
+#include <cstdint>
+
+// Streams CPU-written texel data into textures through pixel unpack buffers,
+// so producers write straight into GPU-visible memory and the texture update
+// is a GPU-side copy. With ARB_buffer_storage the regions of one buffer stay
+// persistently mapped; otherwise each region is a separate buffer that is
+// orphaned and mapped again for every frame. Fences keep a region from being
+// rewritten while its upload is still in flight.
+struct TextureStream {
+  static constexpr int RING_SIZE = 3;
+
+  explicit TextureStream(const GLExtensions &ext)
+      : ext(ext), use_storage(ext.buffer_storage) {
+    glGenBuffers(RING_SIZE, buffers);
+  }
+
+  ~TextureStream() {
+    release();
+    glDeleteBuffers(RING_SIZE, buffers);
+  }
+
+  TextureStream(const TextureStream &) = delete;
+  TextureStream &operator=(const TextureStream &) = delete;
+
+  bool persistent() const noexcept { return use_storage; }
+
+  // Returns memory for size bytes that stays valid until upload(), or null
+  // if the buffer could not be mapped. Only waits when all regions are still
+  // being read by the GPU.
+  void *map(std::size_t size) {
+    if (size > capacity) {
+      reserve(size);
+    }
+    Region &region = regions[next];
+    if (region.fence) {
+      if (glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) ==
+          GL_TIMEOUT_EXPIRED) {
+        ++waits;
+        glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                         GLuint64(-1));
+      }
+      glDeleteSync(region.fence);
+      region.fence = nullptr;
+    }
+    if (persistent()) {
+      return static_cast<std::uint8_t *>(mapping) + next * capacity;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[next]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    void *data = glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return data;
+  }
+
+  // Copies the region returned by the last map() into the 2D texture bound
+  // to the active unit
+  void upload(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+    GLuint buffer = persistent() ? buffers[0] : buffers[next];
+    std::size_t offset = persistent() ? next * capacity : 0;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    if (!persistent()) {
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type,
+                    reinterpret_cast<const void *>(offset));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    regions[next].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next = (next + 1) % RING_SIZE;
+  }
+
+  // Times map() had to block on the GPU
+  unsigned waits = 0;
+
+private:
+  struct Region {
+    GLsync fence = nullptr;
+  };
+
+  const GLExtensions &ext;
+  bool use_storage;
+  GLuint buffers[RING_SIZE];
+  Region regions[RING_SIZE];
+  int next = 0;
+  std::size_t capacity = 0;
+  void *mapping = nullptr;
+
+  void release() {
+    for (Region &region : regions) {
+      if (region.fence) {
+        glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                         GLuint64(-1));
+        glDeleteSync(region.fence);
+        region.fence = nullptr;
+      }
+    }
+    if (mapping) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[0]);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      mapping = nullptr;
+    }
+  }
+
+  // Immutable storage can not be resized, it is replaced by a new buffer
+  void reserve(std::size_t size) {
+    release();
+    capacity = size;
+    if (!persistent()) {
+      return;
+    }
+    glDeleteBuffers(1, &buffers[0]);
+    glGenBuffers(1, &buffers[0]);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[0]);
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    ext.BufferStorage(GL_PIXEL_UNPACK_BUFFER, RING_SIZE * capacity, nullptr,
+                      flags);
+    mapping = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                               RING_SIZE * capacity, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!mapping) {
+      SDL_Log("Could not map the upload buffer persistently, orphaning it");
+      use_storage = false;
+      glDeleteBuffers(1, &buffers[0]);
+      glGenBuffers(1, &buffers[0]);
+    }
+  }
+};
+
+#endif // texture_stream_hpp_INCLUDED
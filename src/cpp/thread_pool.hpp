@@ -0,0 +1,102 @@
+#ifndef thread_pool_hpp_INCLUDED
+#define thread_pool_hpp_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers for data-parallel loops. The calling thread takes part
+// in the work, so a pool with no workers runs everything inline.
+struct ThreadPool {
+  explicit ThreadPool(
+      unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+    for (unsigned i = 1; i < threads; ++i) {
+      workers.emplace_back([this] { run(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned size() const noexcept { return workers.size() + 1; }
+
+  // Calls fn(i) for every i in [0, count) and returns once all calls are
+  // done. Indices are handed out one at a time, which balances rows of very
+  // different cost.
+  void parallel_for(int count, const std::function<void(int)> &fn) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &fn;
+      job_size = count;
+      next = 0;
+      remaining = count;
+      ++generation;
+    }
+    wake.notify_all();
+    int finished = work();
+    std::unique_lock<std::mutex> lock(mutex);
+    remaining -= finished;
+    // Workers must leave work() before the next job resets the counter
+    done.wait(lock, [this] { return remaining == 0 && active == 0; });
+    job = nullptr;
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  const std::function<void(int)> *job = nullptr;
+  int job_size = 0;
+  std::atomic<int> next = 0;
+  int remaining = 0;
+  int active = 0;
+  unsigned generation = 0;
+  bool stop = false;
+
+  int work() {
+    int finished = 0;
+    for (int i; (i = next.fetch_add(1)) < job_size;) {
+      (*job)(i);
+      ++finished;
+    }
+    return finished;
+  }
+
+  void run() {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [&] { return stop || (job && generation != seen); });
+      if (stop) {
+        return;
+      }
+      seen = generation;
+      ++active;
+      lock.unlock();
+      int finished = work();
+      lock.lock();
+      remaining -= finished;
+      if (--active == 0) {
+        done.notify_all();
+      }
+    }
+  }
+};
+
+#endif // thread_pool_hpp_INCLUDED
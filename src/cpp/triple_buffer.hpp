@@ -0,0 +1,39 @@
+#ifndef triple_buffer_hpp_INCLUDED
+#define triple_buffer_hpp_INCLUDED
+
+#include <atomic>
+
+// Hands the newest value from one producer thread to one consumer thread
+// without locks. Each side owns a slot, the third one is swapped through an
+// atomic index, so neither side ever waits and the consumer always sees a
+// complete value. Values the consumer did not pick up in time are skipped.
+template <typename T> struct TripleBuffer {
+  // Producer side: fill write_slot(), then publish() it
+  T &write_slot() noexcept { return slots[back]; }
+
+  void publish() noexcept {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Consumer side: returns whether read() changed
+  bool update() noexcept {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  const T &read() const noexcept { return slots[front]; }
+
+private:
+  static constexpr unsigned INDEX = 3;
+  static constexpr unsigned FRESH = 4;
+
+  T slots[3] = {};
+  unsigned back = 0;
+  unsigned front = 1;
+  std::atomic<unsigned> middle = 2;
+};
+
+#endif // triple_buffer_hpp_INCLUDED
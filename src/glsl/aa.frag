@@ -0,0 +1,71 @@
+#version 330 core
+
+// Re-evaluates high-variance pixels of the iteration data with jittered
+// subsamples, the rest are discarded and keep their single-sample value
+
+out vec4 FragData;
+
+// Per-frame view parameters, see ViewUniforms in shaders.hpp
+layout(std140) uniform View {
+  vec2 window_size;
+  // The iteration data may cover only a corner of the window-sized texture
+  vec2 data_size;
+  // Values in double precision are passed as a float sum of two parts
+  vec2 center;
+  vec2 center_lo;
+  float scale;
+  float scale_lo;
+  int iterations;
+  // Smallest and largest smooth iteration counts of the escaped pixels in x
+  // and w, written by the histogram pass
+  vec4 iteration_range;
+};
+
+uniform sampler2D iteration_data;
+uniform int samples_per_axis;
+uniform float threshold;
+
+vec2 fractal_at(vec2 frag_coord);
+
+float hash(vec2 p) {
+  return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+void main() {
+  ivec2 xy = ivec2(gl_FragCoord.xy);
+  float sum = 0.0;
+  float sum_sq = 0.0;
+  for (int dy = -1; dy <= 1; ++dy) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      ivec2 p = clamp(xy + ivec2(dx, dy), ivec2(0), ivec2(data_size) - 1);
+      vec4 data = texelFetch(iteration_data, p, 0);
+      float v = data.z <= 0.0 ? float(iterations) : data.x / data.z;
+      sum += v;
+      sum_sq += v * v;
+    }
+  }
+  float mean = sum / 9.0;
+  float variance = max(sum_sq / 9.0 - mean * mean, 0.0);
+  if (variance <= threshold * threshold) {
+    discard;
+  }
+
+  vec2 escaped_sum = vec2(0.0);
+  int escaped = 0;
+  float step = 1.0 / samples_per_axis;
+  for (int j = 0; j < samples_per_axis; ++j) {
+    for (int i = 0; i < samples_per_axis; ++i) {
+      vec2 cell = vec2(i, j);
+      vec2 jitter = vec2(hash(gl_FragCoord.xy + cell),
+                         hash(gl_FragCoord.xy - cell + 0.5));
+      vec2 frag_coord = floor(gl_FragCoord.xy) + (cell + jitter) * step;
+      vec2 data = fractal_at(frag_coord);
+      if (data.x >= 0.0) {
+        escaped_sum += data;
+        ++escaped;
+      }
+    }
+  }
+  float samples = float(samples_per_axis * samples_per_axis);
+  FragData = vec4(escaped_sum / samples, float(escaped) / samples, 0.0);
+}
@@ -0,0 +1,75 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// Per-frame view parameters, see ViewUniforms in shaders.hpp
+layout(std140) uniform View {
+  vec2 window_size;
+  // The iteration data may cover only a corner of the window-sized texture
+  vec2 data_size;
+  // Values in double precision are passed as a float sum of two parts
+  vec2 center;
+  vec2 center_lo;
+  float scale;
+  float scale_lo;
+  int iterations;
+  // Smallest and largest smooth iteration counts of the escaped pixels in x
+  // and w, written by the histogram pass
+  vec4 iteration_range;
+};
+
+uniform sampler2D iteration_data;
+uniform sampler1D palette;
+uniform sampler2D cdf;
+uniform int histogram_bins;
+uniform int color_mode;
+uniform float palette_period;
+uniform float palette_offset;
+uniform float palette_speed;
+uniform float time;
+
+const int COLOR_MODE_ITERATIONS = 0;
+const int COLOR_MODE_DISTANCE = 1;
+const int COLOR_MODE_PALETTE = 2;
+const int COLOR_MODE_HISTOGRAM = 3;
+
+// Fraction of escaped pixels with a smaller iteration count
+float equalize(float nu) {
+  float span = max(iteration_range.w - iteration_range.x, 1.0);
+  float bin = max(nu - iteration_range.x, 0.0) / span * histogram_bins;
+  int b = min(int(bin), histogram_bins - 1);
+  float below = b > 0 ? texelFetch(cdf, ivec2(b - 1, 0), 0).x : 0.0;
+  float upto = texelFetch(cdf, ivec2(b, 0), 0).x;
+  float total = texelFetch(cdf, ivec2(histogram_bins - 1, 0), 0).x;
+  return mix(below, upto, clamp(bin - b, 0.0, 1.0)) / max(total, 1.0);
+}
+
+vec3 exterior_color(vec2 data) {
+  if (color_mode == COLOR_MODE_PALETTE) {
+    float t = data.x / palette_period + palette_offset + palette_speed * time;
+    return texture(palette, fract(t)).rgb;
+  }
+  if (color_mode == COLOR_MODE_HISTOGRAM) {
+    float t = equalize(data.x) + palette_offset + palette_speed * time;
+    return texture(palette, fract(t)).rgb;
+  }
+  if (color_mode == COLOR_MODE_DISTANCE) {
+    return vec3(clamp(data.y / 4.0, 0.0, 1.0));
+  }
+  return vec3(1.0 - data.x / iterations);
+}
+
+void main() {
+  // The data may be rendered at a lower resolution into the corner of the
+  // texture, stay within that region when filtering
+  vec2 xy = gl_FragCoord.xy / window_size * data_size;
+  xy = clamp(xy, vec2(0.5), data_size - 0.5);
+  vec4 data = texture(iteration_data, xy / textureSize(iteration_data, 0));
+
+  // Interior is black, anti-aliased pixels blend towards it by coverage
+  if (data.z <= 0.0) {
+    FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+    return;
+  }
+  FragColor = vec4(exterior_color(data.xy / data.z) * data.z, 1.0);
+}
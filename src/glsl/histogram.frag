@@ -0,0 +1,6 @@
+#version 330 core
+
+in vec4 point_value;
+out vec4 FragValue;
+
+void main() { FragValue = point_value; }
@@ -0,0 +1,49 @@
+#version 330 core
+
+// One point per pixel of the iteration data, scattered into its bin. The
+// range pass first blends them all into a single texel instead, for the
+// range the bins span.
+
+// Per-frame view parameters, see ViewUniforms in shaders.hpp
+layout(std140) uniform View {
+  vec2 window_size;
+  // The iteration data may cover only a corner of the window-sized texture
+  vec2 data_size;
+  // Values in double precision are passed as a float sum of two parts
+  vec2 center;
+  vec2 center_lo;
+  float scale;
+  float scale_lo;
+  int iterations;
+  // Smallest and largest smooth iteration counts of the escaped pixels in x
+  // and w, written by the histogram pass
+  vec4 iteration_range;
+};
+
+uniform sampler2D iteration_data;
+uniform int bins;
+uniform bool range_pass;
+
+out vec4 point_value;
+
+void main() {
+  int width = int(data_size.x);
+  ivec2 xy = ivec2(gl_VertexID % width, gl_VertexID / width);
+  vec4 data = texelFetch(iteration_data, xy, 0);
+  if (data.z <= 0.0) {
+    // Interior points are not counted, move them out of the clip volume
+    gl_Position = vec4(2.0, 2.0, 0.0, 1.0);
+    return;
+  }
+  float nu = data.x / data.z;
+  if (range_pass) {
+    point_value = vec4(nu);
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+    return;
+  }
+  float span = max(iteration_range.w - iteration_range.x, 1.0);
+  float bin = clamp(floor((nu - iteration_range.x) / span * bins), 0.0,
+                    bins - 1);
+  point_value = vec4(1.0);
+  gl_Position = vec4(2.0 * (bin + 0.5) / bins - 1.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,118 @@
+#version 330 core
+
+// Escape-time kernel shared by the fractal, anti-aliasing and compute
+// passes. Compiled in variants, see gen_hexdumps.cmake for the defines.
+
+#ifdef PRECISION_DOUBLE
+#extension GL_ARB_gpu_shader_fp64 : require
+#define real double
+#define vec2r dvec2
+#else
+#define real float
+#define vec2r vec2
+#endif
+
+// Per-frame view parameters, see ViewUniforms in shaders.hpp
+layout(std140) uniform View {
+  vec2 window_size;
+  // The iteration data may cover only a corner of the window-sized texture
+  vec2 data_size;
+  // Values in double precision are passed as a float sum of two parts
+  vec2 center;
+  vec2 center_lo;
+  float scale;
+  float scale_lo;
+  int iterations;
+  // Smallest and largest smooth iteration counts of the escaped pixels in x
+  // and w, written by the histogram pass
+  vec4 iteration_range;
+};
+
+vec2r pixel_to_c(vec2 frag_coord) {
+  float min_dim = min(data_size.x, data_size.y);
+  vec2 xy = (2.0 * frag_coord - data_size) / min_dim;
+#ifdef PRECISION_DOUBLE
+  return (vec2r(xy) + vec2r(center) + vec2r(center_lo)) /
+         (real(scale) + real(scale_lo));
+#else
+  return (xy + center) / scale;
+#endif
+}
+
+bool is_interior(vec2r c) {
+#if defined(INTERIOR_CHECKED) && defined(FORMULA_MANDELBROT)
+  // Main cardioid and period-2 bulb
+  real x = c.x - 0.25;
+  real q = x * x + c.y * c.y;
+  if (q * (q + x) <= 0.25 * c.y * c.y) {
+    return true;
+  }
+  real x1 = c.x + 1.0;
+  return x1 * x1 + c.y * c.y <= 0.0625;
+#else
+  return false;
+#endif
+}
+
+vec2r iterate(vec2r z, vec2r c) {
+#if defined(FORMULA_BURNING_SHIP)
+  return vec2r(z.x * z.x - z.y * z.y, 2.0 * abs(z.x * z.y)) + c;
+#elif defined(FORMULA_TRICORN)
+  return vec2r(z.x * z.x - z.y * z.y, -2.0 * z.x * z.y) + c;
+#else
+  return vec2r(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;
+#endif
+}
+
+const float LIMIT = 65536.0;
+
+// One iteration, dz is only tracked for the distance coloring, as the
+// complex derivative for the holomorphic map and its magnitude otherwise
+void advance(inout vec2r z, inout vec2r dz, vec2r c) {
+#ifdef COLORING_DISTANCE
+#ifdef FORMULA_MANDELBROT
+  dz = 2.0 * vec2r(z.x * dz.x - z.y * dz.y, z.x * dz.y + z.y * dz.x) +
+       vec2r(1.0, 0.0);
+#else
+  dz = vec2r(2.0 * length(vec2(z)) * dz.x + 1.0, 0.0);
+#endif
+#endif
+  z = iterate(z, c);
+}
+
+bool has_escaped(vec2r z) { return dot(z, z) > LIMIT; }
+
+// Result for a point that escaped after n iterations
+vec2 escaped(vec2r z, vec2r dz, int n) {
+  vec2 zf = vec2(z);
+  float log_r = 0.5 * log(dot(zf, zf));
+  float nu = float(n) - log2(log_r);
+#ifdef COLORING_DISTANCE
+  // dc/dpixel = 2 / (min_dim * scale)
+  vec2 dzf = vec2(dz);
+  float min_dim = min(data_size.x, data_size.y);
+  float de = 0.5 * sqrt(dot(zf, zf) / dot(dzf, dzf)) * log_r;
+  return vec2(max(nu, 0.0), de * 0.5 * min_dim * scale);
+#else
+  return vec2(max(nu, 0.0), 0.0);
+#endif
+}
+
+vec2 escape_time(vec2r c) {
+  if (is_interior(c)) {
+    return vec2(-1.0, 0.0);
+  }
+  vec2r z = vec2r(0);
+  vec2r dz = vec2r(0);
+  for (int i = 0; i < iterations; ++i) {
+    advance(z, dz, c);
+    if (has_escaped(z)) {
+      return escaped(z, dz, i + 1);
+    }
+  }
+  return vec2(-1.0, 0.0);
+}
+
+// x: continuous iteration count, negative for interior points
+// y: exterior distance estimate, in pixels
+vec2 fractal_at(vec2 frag_coord) { return escape_time(pixel_to_c(frag_coord)); }
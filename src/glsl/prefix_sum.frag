@@ -0,0 +1,17 @@
+#version 330 core
+
+// One step of a Hillis-Steele inclusive scan over a single row
+
+out float FragSum;
+
+uniform sampler2D values;
+uniform int offset;
+
+void main() {
+  int x = int(gl_FragCoord.x);
+  float sum = texelFetch(values, ivec2(x, 0), 0).x;
+  if (x >= offset) {
+    sum += texelFetch(values, ivec2(x - offset, 0), 0).x;
+  }
+  FragSum = sum;
+}
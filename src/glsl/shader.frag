@@ -1,25 +1,13 @@
 #version 330 core
 
-out vec4 FragColor;
+// z: fraction of the pixel outside the set
+// x, y: continuous iteration count and exterior distance estimate in pixels,
+// premultiplied by z so that the data can be filtered when upscaling
+out vec4 FragData;
 
-uniform vec2 window_size;
-uniform vec2 center;
-uniform float scale;
-uniform int iterations;
+vec2 fractal_at(vec2 frag_coord);
 
 void main() {
-  const float LIMIT = 1000.0;
-  float min_dim = min(window_size.x, window_size.y);
-  vec2 xy = 2.0 * gl_FragCoord.xy - window_size;
-  vec2 c = (xy / min_dim + center) / scale;
-  vec2 z = vec2(0);
-  int i;
-  for (i = 0; i < iterations; ++i) {
-    z = vec2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;
-    if (dot(z, z) > LIMIT) {
-      break;
-    }
-  }
-  float r = 1.0 - float(i) / iterations;
-  FragColor = vec4(vec3(r), 1.0);
+  vec2 data = fractal_at(gl_FragCoord.xy);
+  FragData = data.x < 0.0 ? vec4(0.0) : vec4(data, 1.0, 0.0);
 }